@@ -0,0 +1,206 @@
+#include "allocator.h"
+
+
+
+/**************************************************************************************************/
+/*	Heap  */
+
+/* The pointer returned by malloc is stored right below the aligned block. */
+static void* heap_alloc_func(void* ctx, uptr size, uptr align)
+{
+	uptr raw, ptr;
+
+	(void)ctx;
+	align = align < sizeof(void*) ? sizeof(void*) : align;
+	raw = (uptr)malloc(size + align + sizeof(void*));
+
+	if (raw == 0)
+		return NULL;
+
+	ptr = (raw + sizeof(void*) + align - 1) & ~(align - 1);
+	((void**)ptr)[-1] = (void*)raw;
+	return (void*)ptr;
+}
+
+static void heap_free_func(void* ctx, void* ptr, uptr size)
+{
+	(void)ctx;
+	(void)size;
+	free(((void**)ptr)[-1]);
+}
+
+static void* heap_realloc_func(void* ctx, void* ptr, uptr old_size, uptr size, uptr align)
+{
+	void* new_ptr = heap_alloc_func(ctx, size, align);
+
+	if ((ptr != NULL) && (new_ptr != NULL))
+	{
+		memcpy(new_ptr, ptr, old_size < size ? old_size : size);
+		heap_free_func(ctx, ptr, old_size);
+	}
+
+	return new_ptr;
+}
+
+allocator heap_allocator(uptr align)
+{
+	allocator a;
+
+	a.alloc = heap_alloc_func;
+	a.realloc = heap_realloc_func;
+	a.free = heap_free_func;
+	a.ctx = NULL;
+	a.align = align;
+	return a;
+}
+
+
+
+/**************************************************************************************************/
+/*	Arena  */
+
+static arena_chunk* arena_new_chunk(arena_chunk* prev, uptr size)
+{
+	arena_chunk* chunk = malloc(sizeof(arena_chunk) + size);
+
+	if (chunk == NULL)
+		throw_exception("arena: out of memory allocating %zu bytes\n", size);
+
+	chunk->prev = prev;
+	chunk->size = size;
+	chunk->used = 0;
+	return chunk;
+}
+
+static u8* arena_chunk_data(arena_chunk* chunk)
+{
+	return (u8*)(chunk + 1);
+}
+
+arena arena_init(uptr size)
+{
+	arena arena;
+
+	arena.chunk_size = size;
+	arena.reserved = size;
+	arena.chunk = arena_new_chunk(NULL, size);
+	return arena;
+}
+
+void arena_destroy(arena* arena)
+{
+	while (arena->chunk != NULL)
+	{
+		arena_chunk* prev = arena->chunk->prev;
+
+		free(arena->chunk);
+		arena->chunk = prev;
+	}
+}
+
+void* arena_push(arena* arena, uptr size, uptr align)
+{
+	arena_chunk* chunk;
+	uptr base, start;
+
+	align = align == 0 ? ARENA_ALIGN : align;
+	chunk = arena->chunk;
+	base = (uptr)arena_chunk_data(chunk);
+	start = (base + chunk->used + align - 1) & ~(align - 1);
+
+	if (start + size > base + chunk->size)
+	{
+		uptr chunk_size = arena->chunk_size > size + align ? arena->chunk_size : size + align;
+
+		chunk = arena_new_chunk(chunk, chunk_size);
+		arena->chunk = chunk;
+		arena->reserved += chunk_size;
+		base = (uptr)arena_chunk_data(chunk);
+		start = (base + align - 1) & ~(align - 1);
+	}
+
+	chunk->used = start + size - base;
+	return (void*)start;
+}
+
+void arena_reset(arena* arena)
+{
+	if ((arena->chunk->prev != NULL) || (arena->chunk->size < arena->reserved))
+	{
+		arena_destroy(arena);
+		arena->chunk_size = arena->reserved;
+		arena->chunk = arena_new_chunk(NULL, arena->reserved);
+	}
+
+	arena->chunk->used = 0;
+}
+
+arena_marker arena_mark(arena* arena)
+{
+	arena_marker marker;
+
+	marker.chunk = arena->chunk;
+	marker.used = arena->chunk->used;
+	return marker;
+}
+
+void arena_rewind(arena* arena, arena_marker marker)
+{
+	while (arena->chunk != marker.chunk)
+	{
+		arena_chunk* prev = arena->chunk->prev;
+
+		free(arena->chunk);
+		arena->chunk = prev;
+	}
+
+	arena->chunk->used = marker.used;
+}
+
+static void* arena_alloc_func(void* ctx, uptr size, uptr align)
+{
+	return arena_push((arena*)ctx, size, align);
+}
+
+static void* arena_realloc_func(void* ctx, void* ptr, uptr old_size, uptr size, uptr align)
+{
+	arena* arena = ctx;
+	arena_chunk* chunk = arena->chunk;
+	u8* data = arena_chunk_data(chunk);
+	void* new_ptr;
+
+	/* The last allocation can grow or shrink in place. */
+	if ((ptr != NULL) && ((u8*)ptr + old_size == data + chunk->used) &&
+		((u8*)ptr + size <= data + chunk->size))
+	{
+		chunk->used = (u8*)ptr + size - data;
+		return ptr;
+	}
+
+	new_ptr = arena_push(arena, size, align);
+
+	if (ptr != NULL)
+		memcpy(new_ptr, ptr, old_size < size ? old_size : size);
+
+	return new_ptr;
+}
+
+static void arena_free_func(void* ctx, void* ptr, uptr size)
+{
+	arena_chunk* chunk = ((arena*)ctx)->chunk;
+
+	if ((u8*)ptr + size == arena_chunk_data(chunk) + chunk->used)
+		chunk->used = (u8*)ptr - arena_chunk_data(chunk);
+}
+
+allocator arena_allocator(arena* arena)
+{
+	allocator a;
+
+	a.alloc = arena_alloc_func;
+	a.realloc = arena_realloc_func;
+	a.free = arena_free_func;
+	a.ctx = arena;
+	a.align = 0;
+	return a;
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+
+
+#include "core.h"
+
+
+
+/**************************************************************************************************/
+/*	Allocator  */
+
+/* Containers hold an 'allocator*', NULL selects malloc/realloc/free directly. 'align' is passed to
+ * every call, 0 selects the natural malloc alignment. 'size' passed to realloc/free is the size
+ * the block was allocated with, allocators are free to ignore it. */
+typedef struct allocator
+{
+	void* (*alloc)(void* ctx, uptr size, uptr align);
+	void* (*realloc)(void* ctx, void* ptr, uptr old_size, uptr size, uptr align);
+	void (*free)(void* ctx, void* ptr, uptr size);
+	void* ctx;
+	uptr align;
+} allocator;
+
+static inline void* mem_alloc(allocator* a, uptr size)
+{
+	return a == NULL ? malloc(size) : a->alloc(a->ctx, size, a->align);
+}
+
+static inline void* mem_realloc(allocator* a, void* ptr, uptr old_size, uptr size)
+{
+	return a == NULL ? realloc(ptr, size) : a->realloc(a->ctx, ptr, old_size, size, a->align);
+}
+
+static inline void mem_free(allocator* a, void* ptr, uptr size)
+{
+	if (a == NULL)
+		free(ptr);
+	else if (ptr != NULL)
+		a->free(a->ctx, ptr, size);
+}
+
+/* Allocator on malloc that aligns every block to 'align' bytes, a power of two. Use CACHE_LINE
+ * to keep hot tables from sharing lines with unrelated data. */
+allocator heap_allocator(uptr align);
+
+
+
+/**************************************************************************************************/
+/*	Arena  */
+
+#define ARENA_ALIGN 16
+
+typedef struct arena_chunk
+{
+	struct arena_chunk* prev;
+	uptr size;
+	uptr used;
+} arena_chunk;
+
+/* Bump allocator over a chain of chunks. Freeing is a no-op except for the last allocation,
+ * memory is released in bulk by arena_reset or arena_rewind. 'reserved' sums the size of every
+ * chunk allocated since the last reset. */
+typedef struct arena
+{
+	arena_chunk* chunk;
+	uptr chunk_size;
+	uptr reserved;
+} arena;
+
+/* Position inside an arena, everything allocated after it is released by arena_rewind. */
+typedef struct arena_marker
+{
+	arena_chunk* chunk;
+	uptr used;
+} arena_marker;
+
+/* 'size' is the capacity of the first chunk in bytes, later chunks are at least as large. */
+arena arena_init(uptr size);
+
+void arena_destroy(arena* arena);
+
+/* 'align' must be a power of two, 0 selects ARENA_ALIGN. */
+void* arena_push(arena* arena, uptr size, uptr align);
+
+/* Release everything. If the arena overflowed its first chunk since the last reset, the chunks
+ * are replaced by one large enough for all of them, so a steady workload stops allocating. */
+void arena_reset(arena* arena);
+
+arena_marker arena_mark(arena* arena);
+
+void arena_rewind(arena* arena, arena_marker marker);
+
+/* Allocator that allocates from 'arena', the arena has to outlive the allocator. */
+allocator arena_allocator(arena* arena);
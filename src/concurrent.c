@@ -0,0 +1,687 @@
+#include "concurrent.h"
+#include "hash.h"
+
+
+
+/**************************************************************************************************/
+
+static concurrent_hashmap_shard* concurrent_hashmap_shard_of(concurrent_hashmap* map, sint hash)
+{
+	/* The low bits index the table, so the shard is picked from the high bits. */
+	return map->shards + (map->shard_bits == 0 ? 0 : ((u32)hash >> (32 - map->shard_bits)));
+}
+
+static void concurrent_hashmap_lock(concurrent_hashmap_shard* shard)
+{
+	while (atomic_cas32(&shard->lock, 0, 1) != 0)
+	{
+		while (atomic_load32(&shard->lock) != 0)
+			cpu_pause();
+	}
+}
+
+static void concurrent_hashmap_unlock(concurrent_hashmap_shard* shard)
+{
+	atomic_store32(&shard->lock, 0);
+}
+
+concurrent_hashmap concurrent_hashmap_init(sint size, sint len, sint shards, hashfunc hash, cmpfunc cmp)
+{
+	concurrent_hashmap map;
+	sint i, count;
+
+	count = shards <= 1 ? 1 : (UINT_MAX >> clz(shards - 1)) + 1;
+
+	map.memory = malloc(sizeof(concurrent_hashmap_shard) * count + CACHE_LINE);
+	map.shards = (concurrent_hashmap_shard*)(((uptr)map.memory + CACHE_LINE - 1) & ~(uptr)(CACHE_LINE - 1));
+	map.shard_bits = ctz(count);
+	map.bucket_size = size;
+	map.hash = hash;
+	map.cmp = cmp;
+
+	for (i = 0; i < count; i++)
+	{
+		concurrent_hashmap_shard* shard = map.shards + i;
+
+		shard->seq = 0;
+		shard->lock = 0;
+		shard->table = malloc(sizeof(flat_hashmap));
+		*shard->table = flat_hashmap_init(size, len / count, hash, cmp);
+		shard->retired = vector_init(sizeof(flat_hashmap*), 0);
+	}
+
+	return map;
+}
+
+void concurrent_hashmap_destroy(concurrent_hashmap* map)
+{
+	sint i;
+
+	concurrent_hashmap_reclaim(map);
+
+	for (i = 0; i < (1 << map->shard_bits); i++)
+	{
+		flat_hashmap_destroy(map->shards[i].table);
+		free(map->shards[i].table);
+		vector_destroy(&map->shards[i].retired);
+	}
+
+	free(map->memory);
+}
+
+sint concurrent_hashmap_get(concurrent_hashmap* map, void* bucket, void* out_bucket)
+{
+	concurrent_hashmap_shard* shard;
+	sint hash, idx, result;
+	u32 seq;
+
+	hash = map->hash(bucket);
+	shard = concurrent_hashmap_shard_of(map, hash);
+
+	for (;;)
+	{
+		flat_hashmap* table;
+		void* _bucket;
+
+		seq = atomic_load32(&shard->seq);
+
+		if (seq & 1)
+		{
+			cpu_pause();
+			continue;
+		}
+
+		/* A table is never freed while readers may hold it, so probing it is always safe, the
+		 * sequence check below only decides whether the result can be trusted. */
+		table = atomic_load_ptr(&shard->table);
+		_bucket = flat_hashmap_get_index(table, hash, bucket, &idx);
+		result = INVALID_INDEX;
+
+		if (_bucket != NULL)
+		{
+			memcpy(out_bucket, _bucket, map->bucket_size);
+			result = SUCCESS;
+		}
+
+		atomic_fence_acquire();
+
+		if (atomic_load32(&shard->seq) == seq)
+			return result;
+	}
+}
+
+sint concurrent_hashmap_push(concurrent_hashmap* map, void* bucket, void* out_bucket)
+{
+	concurrent_hashmap_shard* shard;
+	flat_hashmap* table;
+	sint hash, idx;
+	void* _bucket;
+
+	hash = map->hash(bucket);
+	shard = concurrent_hashmap_shard_of(map, hash);
+
+	concurrent_hashmap_lock(shard);
+	table = shard->table;
+	_bucket = flat_hashmap_get_index(table, hash, bucket, &idx);
+
+	if (_bucket != NULL)
+	{
+		if (out_bucket != NULL)
+			memcpy(out_bucket, _bucket, map->bucket_size);
+
+		concurrent_hashmap_unlock(shard);
+		return INVALID_INDEX;
+	}
+
+	if ((table->len + 1) > (table->cap - (table->cap / 4)))
+	{
+		/* Build the grown table on the side while readers keep using the old one, then publish
+		 * it with a single pointer store. */
+		flat_hashmap* new_table = malloc(sizeof(flat_hashmap));
+
+		*new_table = flat_hashmap_init(map->bucket_size, (table->len + 1) * 2, map->hash, map->cmp);
+		flat_hashmap_rehash_into(new_table, table);
+		flat_hashmap_insert(new_table, hash, bucket);
+
+		atomic_store_ptr(&shard->table, new_table);
+		vector_push(&shard->retired, &table);
+	}
+	else
+	{
+		/* The odd sequence has to be visible before any of the table writes. */
+		atomic_add32(&shard->seq, 1);
+		atomic_fence_release();
+		flat_hashmap_insert(table, hash, bucket);
+		atomic_add32(&shard->seq, 1);
+	}
+
+	concurrent_hashmap_unlock(shard);
+	return SUCCESS;
+}
+
+sint concurrent_hashmap_pop(concurrent_hashmap* map, void* bucket, void* out_bucket)
+{
+	concurrent_hashmap_shard* shard;
+	flat_hashmap* table;
+	sint hash, idx;
+	void* _bucket;
+
+	hash = map->hash(bucket);
+	shard = concurrent_hashmap_shard_of(map, hash);
+
+	concurrent_hashmap_lock(shard);
+	table = shard->table;
+	_bucket = flat_hashmap_get_index(table, hash, bucket, &idx);
+
+	if (_bucket == NULL)
+	{
+		concurrent_hashmap_unlock(shard);
+		return INVALID_INDEX;
+	}
+
+	memcpy(out_bucket, _bucket, map->bucket_size);
+
+	atomic_add32(&shard->seq, 1);
+	atomic_fence_release();
+	flat_hashmap_erase_index(table, idx);
+	atomic_add32(&shard->seq, 1);
+
+	concurrent_hashmap_unlock(shard);
+	return SUCCESS;
+}
+
+void concurrent_hashmap_reclaim(concurrent_hashmap* map)
+{
+	sint i, j;
+
+	for (i = 0; i < (1 << map->shard_bits); i++)
+	{
+		concurrent_hashmap_shard* shard = map->shards + i;
+
+		concurrent_hashmap_lock(shard);
+
+		for (j = 0; j < shard->retired.len; j++)
+		{
+			flat_hashmap* table = *(flat_hashmap**)vector_get(&shard->retired, j);
+
+			flat_hashmap_destroy(table);
+			free(table);
+		}
+
+		shard->retired.len = 0;
+		vector_trim(&shard->retired);
+		concurrent_hashmap_unlock(shard);
+	}
+}
+
+sint concurrent_hashmap_len(concurrent_hashmap* map)
+{
+	sint i, len;
+
+	for (i = 0, len = 0; i < (1 << map->shard_bits); i++)
+		len += ((flat_hashmap*)atomic_load_ptr(&map->shards[i].table))->len;
+
+	return len;
+}
+
+
+
+/**************************************************************************************************/
+
+spsc_queue spsc_queue_init(sint size, sint cap)
+{
+	spsc_queue queue;
+
+	cap = get_container_capacity(cap);
+
+	queue.head = 0;
+	queue.cached_tail = 0;
+	queue.tail = 0;
+	queue.cached_head = 0;
+	queue.data = malloc((uptr)cap * size);
+	queue.elem_size = size;
+	queue.mask = cap - 1;
+	return queue;
+}
+
+void spsc_queue_destroy(spsc_queue* queue)
+{
+	free(queue->data);
+}
+
+/* Copies 'count' elems between the ring starting at cursor 'pos' and 'elems', in two parts if
+ * the range wraps around. */
+static void spsc_queue_copy(spsc_queue* queue, u32 pos, void* elems, sint count, sint to_ring)
+{
+	u8* ring;
+	uptr first, rest;
+
+	ring = queue->data + (uptr)(pos & queue->mask) * queue->elem_size;
+	first = (uptr)(queue->mask + 1 - (pos & queue->mask));
+	first = (first < (uptr)count ? first : (uptr)count) * queue->elem_size;
+	rest = (uptr)count * queue->elem_size - first;
+
+	if (to_ring)
+	{
+		memcpy(ring, elems, first);
+		memcpy(queue->data, (u8*)elems + first, rest);
+	}
+	else
+	{
+		memcpy(elems, ring, first);
+		memcpy((u8*)elems + first, queue->data, rest);
+	}
+}
+
+sint spsc_queue_push(spsc_queue* queue, void* elem)
+{
+	return spsc_queue_push_many(queue, elem, 1) == 1 ? SUCCESS : INVALID_INDEX;
+}
+
+sint spsc_queue_pop(spsc_queue* queue, void* out_elem)
+{
+	return spsc_queue_pop_many(queue, out_elem, 1) == 1 ? SUCCESS : INVALID_INDEX;
+}
+
+sint spsc_queue_push_many(spsc_queue* queue, void* elems, sint count)
+{
+	u32 tail, space;
+
+	tail = queue->tail;
+	space = queue->mask + 1 - (tail - queue->cached_head);
+
+	if (space < (u32)count)
+	{
+		queue->cached_head = atomic_load32(&queue->head);
+		space = queue->mask + 1 - (tail - queue->cached_head);
+	}
+
+	if ((u32)count > space)
+		count = (sint)space;
+
+	if (count == 0)
+		return 0;
+
+	spsc_queue_copy(queue, tail, elems, count, 1);
+	atomic_store32(&queue->tail, tail + count);
+	return count;
+}
+
+sint spsc_queue_pop_many(spsc_queue* queue, void* out_elems, sint count)
+{
+	u32 head, avail;
+
+	head = queue->head;
+	avail = queue->cached_tail - head;
+
+	if (avail < (u32)count)
+	{
+		queue->cached_tail = atomic_load32(&queue->tail);
+		avail = queue->cached_tail - head;
+	}
+
+	if ((u32)count > avail)
+		count = (sint)avail;
+
+	if (count == 0)
+		return 0;
+
+	spsc_queue_copy(queue, head, out_elems, count, 0);
+	atomic_store32(&queue->head, head + count);
+	return count;
+}
+
+
+
+/**************************************************************************************************/
+
+/* Cells are a u32 sequence followed by the elem, padded to keep elems pointer aligned. */
+#define MPMC_CELL_DATA(cell) ((cell) + sizeof(void*))
+#define MPMC_CELL(queue, pos) ((queue)->cells + (uptr)((pos) & (queue)->mask) * (queue)->stride)
+
+mpmc_queue mpmc_queue_init(sint size, sint cap)
+{
+	mpmc_queue queue;
+	u32 i;
+
+	cap = get_container_capacity(cap);
+
+	queue.head = 0;
+	queue.tail = 0;
+	queue.elem_size = size;
+	queue.stride = (sint)((sizeof(void*) + size + sizeof(void*) - 1) & ~(sizeof(void*) - 1));
+	queue.mask = cap - 1;
+	queue.cells = malloc((uptr)cap * queue.stride);
+
+	for (i = 0; i < (u32)cap; i++)
+		*(u32*)MPMC_CELL(&queue, i) = i;
+
+	return queue;
+}
+
+void mpmc_queue_destroy(mpmc_queue* queue)
+{
+	free(queue->cells);
+}
+
+sint mpmc_queue_push(mpmc_queue* queue, void* elem)
+{
+	return mpmc_queue_push_many(queue, elem, 1) == 1 ? SUCCESS : INVALID_INDEX;
+}
+
+sint mpmc_queue_pop(mpmc_queue* queue, void* out_elem)
+{
+	return mpmc_queue_pop_many(queue, out_elem, 1) == 1 ? SUCCESS : INVALID_INDEX;
+}
+
+/* Claims the run of up to 'count' cells at the cursor whose sequence is the cursor plus 'lap',
+ * returns the first claimed position in 'out_pos'. */
+static sint mpmc_queue_claim(mpmc_queue* queue, volatile u32* cursor, u32 lap, sint count, u32* out_pos)
+{
+	u32 pos, seen;
+	sint n;
+
+	pos = atomic_load32(cursor);
+
+	for (;;)
+	{
+		for (n = 0; n < count; n++)
+		{
+			u32 seq = atomic_load32((u32*)MPMC_CELL(queue, pos + n));
+
+			if (seq != pos + n + lap)
+				break;
+		}
+
+		if (n == 0)
+		{
+			u32 seq = atomic_load32((u32*)MPMC_CELL(queue, pos));
+
+			/* The cell is a lap behind, so the queue is full or empty. */
+			if ((s32)(seq - (pos + lap)) < 0)
+				return 0;
+
+			pos = atomic_load32(cursor);
+			continue;
+		}
+
+		seen = atomic_cas32(cursor, pos, pos + n);
+
+		if (seen == pos)
+		{
+			*out_pos = pos;
+			return n;
+		}
+
+		pos = seen;
+		cpu_pause();
+	}
+}
+
+sint mpmc_queue_push_many(mpmc_queue* queue, void* elems, sint count)
+{
+	u32 pos;
+	sint i, n;
+
+	n = mpmc_queue_claim(queue, &queue->tail, 0, count, &pos);
+
+	for (i = 0; i < n; i++)
+	{
+		u8* cell = MPMC_CELL(queue, pos + i);
+
+		memcpy(MPMC_CELL_DATA(cell), (u8*)elems + (uptr)i * queue->elem_size, queue->elem_size);
+		atomic_store32((u32*)cell, pos + i + 1);
+	}
+
+	return n;
+}
+
+sint mpmc_queue_pop_many(mpmc_queue* queue, void* out_elems, sint count)
+{
+	u32 pos;
+	sint i, n;
+
+	n = mpmc_queue_claim(queue, &queue->head, 1, count, &pos);
+
+	for (i = 0; i < n; i++)
+	{
+		u8* cell = MPMC_CELL(queue, pos + i);
+
+		memcpy((u8*)out_elems + (uptr)i * queue->elem_size, MPMC_CELL_DATA(cell), queue->elem_size);
+		atomic_store32((u32*)cell, pos + i + queue->mask + 1);
+	}
+
+	return n;
+}
+
+
+
+/**************************************************************************************************/
+
+/* Plain data, the compare runs inside the seqlock window and must not follow pointers. Equal
+ * hashes and lengths count as a match there, the string is checked on the validated copy. */
+typedef struct intern_bucket
+{
+	u32 hash;
+	u32 hash_hi;
+	u32 len;
+	atom id;
+} intern_bucket;
+
+static void intern_hash(intern_bucket* bucket, const char* str, sint len, uptr seed)
+{
+#if defined(PLATFORM_HAS_I64)
+	u64 hash = hash_bytes(str, (uptr)len, (u64)seed);
+
+	bucket->hash = (u32)hash;
+	bucket->hash_hi = (u32)(hash >> 32);
+
+#else
+	u32 lo = 2166136261u ^ (u32)seed;
+	u32 hi = 2166136261u ^ ~(u32)seed;
+	sint i;
+
+	/* Two FNV-1a streams with different seeds */
+	for (i = 0; i < len; i++)
+	{
+		lo = (lo ^ (u8)str[i]) * 16777619u;
+		hi = (hi ^ (u8)str[i]) * 16777619u;
+	}
+
+	bucket->hash = lo;
+	bucket->hash_hi = hi;
+
+#endif
+
+	bucket->len = (u32)len;
+	bucket->id = ATOM_NONE;
+}
+
+static sint intern_bucket_hash(void* bucket)
+{
+	return (sint)((intern_bucket*)bucket)->hash;
+}
+
+static sint intern_bucket_cmp(void* a, void* b)
+{
+	intern_bucket* x = a;
+	intern_bucket* y = b;
+
+	return (x->hash != y->hash) | (x->hash_hi != y->hash_hi) | (x->len != y->len);
+}
+
+/* Chunk holding the entry of atom index 'idx'. */
+static sint intern_chunk(u32 idx)
+{
+	return (31 - clz(idx + INTERN_CHUNK_MIN)) - ctz(INTERN_CHUNK_MIN);
+}
+
+static const char** intern_entry(intern_table* table, u32 idx)
+{
+	sint k = intern_chunk(idx);
+	return table->chunks[k] + (idx + INTERN_CHUNK_MIN - ((u32)INTERN_CHUNK_MIN << k));
+}
+
+static void intern_lock(intern_table* table)
+{
+	while (atomic_cas32(&table->lock, 0, 1) != 0)
+	{
+		while (atomic_load32(&table->lock) != 0)
+			cpu_pause();
+	}
+}
+
+static void intern_unlock(intern_table* table)
+{
+	atomic_store32(&table->lock, 0);
+}
+
+static sint intern_matches(intern_table* table, atom id, const char* str, sint len)
+{
+	return (atom_len(table, id) == len) && (memcmp(atom_str(table, id), str, (uptr)len) == 0);
+}
+
+/* Caller holds the lock. */
+static atom intern_find_collision(intern_table* table, const char* str, sint len)
+{
+	sint i;
+
+	for (i = 0; i < table->collisions.len; i++)
+	{
+		atom id = *(atom*)vector_get(&table->collisions, i);
+
+		if (intern_matches(table, id, str, len))
+			return id;
+	}
+
+	return ATOM_NONE;
+}
+
+intern_table intern_table_init(sint len)
+{
+	intern_table table;
+
+	/* Writers serialize on 'lock' anyway, so a single shard is enough. */
+	table.map = concurrent_hashmap_init(sizeof(intern_bucket), len, 1, intern_bucket_hash,
+		intern_bucket_cmp);
+	table.collisions = vector_init(sizeof(atom), 0);
+	table.strings = arena_init((uptr)(len < INTERN_CHUNK_MIN ? INTERN_CHUNK_MIN : len) * 32);
+	table.count = 0;
+	table.lock = 0;
+	memset(table.chunks, 0, sizeof(table.chunks));
+
+#if defined(PLATFORM_HAS_I64)
+	table.seed = (uptr)hash_make_seed(&table);
+#else
+	table.seed = (uptr)&table;
+#endif
+
+	return table;
+}
+
+void intern_table_destroy(intern_table* table)
+{
+	sint i;
+
+	for (i = 0; i < INTERN_CHUNKS; i++)
+		free((void*)table->chunks[i]);
+
+	concurrent_hashmap_destroy(&table->map);
+	vector_destroy(&table->collisions);
+	arena_destroy(&table->strings);
+}
+
+atom intern_find(intern_table* table, const char* str, sint len)
+{
+	intern_bucket bucket, found;
+	atom id;
+
+	intern_hash(&bucket, str, len, table->seed);
+
+	if (concurrent_hashmap_get(&table->map, &bucket, &found) != SUCCESS)
+		return ATOM_NONE;
+
+	if (intern_matches(table, found.id, str, len))
+		return found.id;
+
+	intern_lock(table);
+	id = intern_find_collision(table, str, len);
+	intern_unlock(table);
+	return id;
+}
+
+atom intern(intern_table* table, const char* str, sint len)
+{
+	intern_bucket bucket, found;
+	sint k, collided;
+	char* copy;
+	u32 idx;
+	atom id;
+
+	intern_hash(&bucket, str, len, table->seed);
+
+	if ((concurrent_hashmap_get(&table->map, &bucket, &found) == SUCCESS) &&
+		intern_matches(table, found.id, str, len))
+	{
+		return found.id;
+	}
+
+	intern_lock(table);
+
+	/* Another writer may have added it in the meantime, or the hash belongs to another string. */
+	collided = concurrent_hashmap_get(&table->map, &bucket, &found) == SUCCESS;
+
+	if (collided)
+	{
+		id = intern_matches(table, found.id, str, len) ? found.id : intern_find_collision(table, str, len);
+
+		if (id != ATOM_NONE)
+		{
+			intern_unlock(table);
+			return id;
+		}
+	}
+
+	idx = table->count;
+	k = intern_chunk(idx);
+
+	if (table->chunks[k] == NULL)
+		table->chunks[k] = malloc(sizeof(const char*) * ((uptr)INTERN_CHUNK_MIN << k));
+
+	copy = arena_push(&table->strings, sizeof(u32) + (uptr)len + 1, sizeof(u32));
+	memcpy(copy, &bucket.len, sizeof(u32));
+	memcpy(copy + sizeof(u32), str, (uptr)len);
+	copy[sizeof(u32) + len] = 0;
+
+	bucket.id = idx + 1;
+	*intern_entry(table, idx) = copy + sizeof(u32);
+
+	/* The entry is written before the push publishes the atom. */
+	if (collided)
+		vector_push(&table->collisions, &bucket.id);
+	else
+		concurrent_hashmap_push(&table->map, &bucket, NULL);
+
+	atomic_store32(&table->count, idx + 1);
+
+	intern_unlock(table);
+	return bucket.id;
+}
+
+atom intern_cstr(intern_table* table, const char* str)
+{
+	return intern(table, str, (sint)strlen(str));
+}
+
+const char* atom_str(intern_table* table, atom id)
+{
+	return *intern_entry(table, id - 1);
+}
+
+sint atom_len(intern_table* table, atom id)
+{
+	u32 len;
+
+	memcpy(&len, atom_str(table, id) - sizeof(u32), sizeof(u32));
+	return (sint)len;
+}
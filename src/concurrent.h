@@ -0,0 +1,184 @@
+#pragma once
+
+
+
+#include "containers.h"
+
+
+
+/**************************************************************************************************/
+
+/* A flat_hashmap guarded by a seqlock for readers and a spinlock for writers. 'table' is
+ * replaced as a whole on resize, the old one is kept in 'retired' until reclaimed. */
+typedef struct concurrent_hashmap_shard
+{
+	cachealign volatile u32 seq;
+	volatile u32 lock;
+	flat_hashmap* table;
+	vector retired;
+} concurrent_hashmap_shard;
+
+/* 'shards' is a power of two, the top bits of the hash select the shard. 20 - 40 bytes. */
+typedef struct concurrent_hashmap
+{
+	concurrent_hashmap_shard* shards;
+	void* memory;
+	sint shard_bits;
+	sint bucket_size;
+	hashfunc hash;
+	cmpfunc cmp;
+} concurrent_hashmap;
+
+
+
+/**************************************************************************************************/
+
+/* Bounded single producer, single consumer ring. Cursors run freely and are masked on access,
+ * each side caches the other cursor and only reloads it when the ring looks full or empty. */
+typedef struct spsc_queue
+{
+	cachealign volatile u32 head;
+	u32 cached_tail;
+	cachealign volatile u32 tail;
+	u32 cached_head;
+	cachealign u8* data;
+	sint elem_size;
+	u32 mask;
+} spsc_queue;
+
+/* Bounded multi producer, multi consumer queue after Dmitry Vyukov. Every cell starts with a
+ * sequence number telling producers and consumers of which lap it is ready for. */
+typedef struct mpmc_queue
+{
+	cachealign volatile u32 head;
+	cachealign volatile u32 tail;
+	cachealign u8* cells;
+	sint elem_size;
+	sint stride;
+	u32 mask;
+} mpmc_queue;
+
+
+
+/**************************************************************************************************/
+
+/* Handle of an interned string, equal strings of one table share it. ATOM_NONE is never
+ * returned for an interned string, so atoms can key an int_hashmap with that as 'empty'. */
+typedef u32 atom;
+
+#define ATOM_NONE 0
+
+/* Atoms index 'chunks', chunk k holds INTERN_CHUNK_MIN << k entries and never moves. */
+#define INTERN_CHUNK_MIN 64
+#define INTERN_CHUNKS 26
+
+/* Strings are stored once in 'strings' behind their u32 length and stay until the table is
+ * destroyed. Lookups are lock-free through 'map', which keys atoms by a 64-bit hash and the
+ * length. New strings are added under 'lock', the rare ones colliding in 'map' with a different
+ * string go to 'collisions' and are searched under the lock. */
+typedef struct intern_table
+{
+	concurrent_hashmap map;
+	vector collisions;
+	arena strings;
+	const char** chunks[INTERN_CHUNKS];
+	volatile u32 count;
+	volatile u32 lock;
+	uptr seed;
+} intern_table;
+
+
+
+/**************************************************************************************************/
+
+/* 'size' is the size of a single bucket in bytes. 'shards' is rounded up to a power of two and
+ * bounds the number of concurrent writers. */
+concurrent_hashmap concurrent_hashmap_init(sint size, sint len, sint shards, hashfunc hash, cmpfunc cmp);
+
+/* No other thread may use the map. */
+void concurrent_hashmap_destroy(concurrent_hashmap* map);
+
+/* Lock-free, the found bucket is copied to 'out_bucket' since it may move at any time. Readers
+ * can observe a bucket while it is being written, 'hash' and 'cmp' have to tolerate that and the
+ * result is discarded, so keys should be plain data or pointers to immutable data. */
+sint concurrent_hashmap_get(concurrent_hashmap* map, void* bucket, void* out_bucket);
+
+/* Returns SUCCESS if the bucket was added. Otherwise the existing bucket is copied to
+ * 'out_bucket' (if not NULL) and INVALID_INDEX is returned. */
+sint concurrent_hashmap_push(concurrent_hashmap* map, void* bucket, void* out_bucket);
+
+/* 'out_bucket' is used to store the data of a bucket if found. Tables never shrink. */
+sint concurrent_hashmap_pop(concurrent_hashmap* map, void* bucket, void* out_bucket);
+
+/* Free the tables replaced by resizes. No thread may be inside concurrent_hashmap_get. */
+void concurrent_hashmap_reclaim(concurrent_hashmap* map);
+
+/* Sum of all shard lengths, only exact while no writer is active. */
+sint concurrent_hashmap_len(concurrent_hashmap* map);
+
+
+
+/**************************************************************************************************/
+
+/* 'size' is the size of a single elem in bytes, 'cap' is rounded up to a power of two. */
+spsc_queue spsc_queue_init(sint size, sint cap);
+
+/* No other thread may use the queue. */
+void spsc_queue_destroy(spsc_queue* queue);
+
+/* Producer only, returns INVALID_INDEX if the queue is full. */
+sint spsc_queue_push(spsc_queue* queue, void* elem);
+
+/* Consumer only, returns INVALID_INDEX if the queue is empty. */
+sint spsc_queue_pop(spsc_queue* queue, void* out_elem);
+
+/* Pushes up to 'count' elems with a single publish, returns the number pushed. */
+sint spsc_queue_push_many(spsc_queue* queue, void* elems, sint count);
+
+/* Pops up to 'count' elems with a single release, returns the number popped. */
+sint spsc_queue_pop_many(spsc_queue* queue, void* out_elems, sint count);
+
+
+
+/**************************************************************************************************/
+
+/* 'size' is the size of a single elem in bytes, 'cap' is rounded up to a power of two. */
+mpmc_queue mpmc_queue_init(sint size, sint cap);
+
+/* No other thread may use the queue. */
+void mpmc_queue_destroy(mpmc_queue* queue);
+
+/* Returns INVALID_INDEX if the queue is full. */
+sint mpmc_queue_push(mpmc_queue* queue, void* elem);
+
+/* Returns INVALID_INDEX if the queue is empty. */
+sint mpmc_queue_pop(mpmc_queue* queue, void* out_elem);
+
+/* Claims up to 'count' consecutive cells with a single CAS, returns the number pushed. */
+sint mpmc_queue_push_many(mpmc_queue* queue, void* elems, sint count);
+
+/* Claims up to 'count' consecutive cells with a single CAS, returns the number popped. */
+sint mpmc_queue_pop_many(mpmc_queue* queue, void* out_elems, sint count);
+
+
+
+/**************************************************************************************************/
+
+/* 'len' is the expected number of unique strings. */
+intern_table intern_table_init(sint len);
+
+/* No other thread may use the table, the strings of its atoms are released. */
+void intern_table_destroy(intern_table* table);
+
+/* Returns the atom of the 'len' bytes at 'str', adding a copy if the table does not hold them. */
+atom intern(intern_table* table, const char* str, sint len);
+
+atom intern_cstr(intern_table* table, const char* str);
+
+/* Like intern, but returns ATOM_NONE instead of adding the string. */
+atom intern_find(intern_table* table, const char* str, sint len);
+
+/* The null-terminated copy of an atom, valid until the table is destroyed. */
+const char* atom_str(intern_table* table, atom id);
+
+sint atom_len(intern_table* table, atom id);
@@ -10,6 +10,7 @@
 /*	Types  */
 
 #define MAX_PARALLEL_FRAMES 3
+#define FRAME_ARENA_SIZE (1 << 20)
 
 typedef struct window_config {
 	uint vsync; /* 0 = NONE, 1 = HALF, 2 = FULL, 3 = FAST */
@@ -1,4 +1,21 @@
 #include "containers.h"
+#include "hash.h"
+
+#if defined(PLATFORM_HAS_SSE2)
+#include <emmintrin.h>
+#elif defined(PLATFORM_HAS_NEON)
+#include <arm_neon.h>
+#endif
+
+
+
+/*************************************************************************************************/
+
+/* Number of keys hashed and prefetched ahead of probing in the *_many functions. */
+#define HASHMAP_BATCH 16
+
+/* Number of old slots or entries moved per operation during an incremental resize. */
+#define HASHMAP_MIGRATE 32
 
 
 
@@ -15,38 +32,41 @@ sint get_container_capacity(sint len)
 
 vector vector_init(sint size, sint len)
 {
-	vector array = { NULL, size, 0, 0 };
+	return vector_init_alloc(size, len, NULL);
+}
+
+vector vector_init_alloc(sint size, sint len, allocator* alloc)
+{
+	vector array = { NULL, size, 0, 0, CONTAINER_SHRINK_DEFAULT, alloc };
 	vector_reserve(&array, len);
 	return array;
 }
 
 void vector_destroy(vector* vec)
 {
-	free(vec->data);
+	mem_free(vec->alloc, vec->data, (uptr)vec->cap * vec->elem_size);
 }
 
 void vector_reserve(vector* vec, sint len)
 {
 	if (vec->cap < len)
 	{
-		void* new_data;
-
 		len = get_container_capacity(len);
-		new_data = malloc((uptr)vec->elem_size * len);
+		vec->data = mem_realloc(vec->alloc, vec->data, (uptr)vec->cap * vec->elem_size,
+			(uptr)len * vec->elem_size);
 		vec->cap = len;
-
-		memcpy(new_data, vec->data, (uptr)vec->len * vec->elem_size);
-		vector_destroy(vec);
-		vec->data = new_data;
 	}
 }
 
 void vector_trim(vector* vec)
 {
-	if ((vec->cap / 4) > vec->len)
+	sint cap = get_container_capacity(vec->len * 2);
+
+	if (cap < vec->cap)
 	{
-		vec->cap = get_container_capacity(vec->len * 2);
-		vec->data = realloc(vec->data, (uptr)vec->cap * vec->elem_size);
+		vec->data = mem_realloc(vec->alloc, vec->data, (uptr)vec->cap * vec->elem_size,
+			(uptr)cap * vec->elem_size);
+		vec->cap = cap;
 	}
 }
 
@@ -89,7 +109,9 @@ void vector_erase(vector* vec, sint idx)
 	sz = (uptr)(vec->len - idx) * vec->elem_size;
 
 	memmove(dst, src, sz);
-	vector_trim(vec);
+
+	if (CONTAINER_SHOULD_SHRINK(vec))
+		vector_trim(vec);
 }
 
 sint vector_find(vector* vec, void* elem, cmpfunc cmp)
@@ -111,56 +133,357 @@ sint vector_find(vector* vec, void* elem, cmpfunc cmp)
 
 
 
+/*************************************************************************************************/
+
+/* Validating decode of one UTF-8 sequence, 'end' bounds the input. Overlong forms, surrogates,
+ * values above U+10FFFF and truncated sequences decode to U+FFFD and consume a single byte. */
+static sint utf8_decode_checked(const u8* p, const u8* end, s32* out_symbol)
+{
+	s32 symbol;
+	u8 c = p[0];
+
+	if (c < 0x80)
+	{
+		*out_symbol = c;
+		return 1;
+	}
+	else if ((c >= 0xC2) & (c <= 0xDF))
+	{
+		if ((end - p >= 2) && (p[1] & 0xC0) == 0x80)
+		{
+			*out_symbol = ((c & 0x1F) << 6) | (p[1] & 0x3F);
+			return 2;
+		}
+	}
+	else if ((c >= 0xE0) & (c <= 0xEF))
+	{
+		if ((end - p >= 3) && (p[1] & 0xC0) == 0x80 && (p[2] & 0xC0) == 0x80)
+		{
+			symbol = ((c & 0xF) << 12) | ((p[1] & 0x3F) << 6) | (p[2] & 0x3F);
+
+			if ((symbol >= 0x800) & ((symbol < 0xD800) | (symbol > 0xDFFF)))
+			{
+				*out_symbol = symbol;
+				return 3;
+			}
+		}
+	}
+	else if ((c >= 0xF0) & (c <= 0xF4))
+	{
+		if ((end - p >= 4) && (p[1] & 0xC0) == 0x80 && (p[2] & 0xC0) == 0x80 && (p[3] & 0xC0) == 0x80)
+		{
+			symbol = ((c & 0x7) << 18) | ((p[1] & 0x3F) << 12) | ((p[2] & 0x3F) << 6) | (p[3] & 0x3F);
+
+			if ((symbol >= 0x10000) & (symbol <= 0x10FFFF))
+			{
+				*out_symbol = symbol;
+				return 4;
+			}
+		}
+	}
+
+	*out_symbol = 0xFFFD;
+	return 1;
+}
+
+/* Number of leading ASCII bytes in a 16 byte block, 16 if all are ASCII. */
+static sint utf8_ascii_block(const u8* p)
+{
+#if defined(PLATFORM_HAS_SSE2)
+	uint mask = (uint)_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)p));
+	return mask == 0 ? 16 : ctz(mask);
+
+#else
+	sint i;
+	u32 w[4];
+
+	/* u32 words, u64 is not defined on every target without SSE2. */
+	memcpy(w, p, 16);
+
+	if (((w[0] | w[1] | w[2] | w[3]) & 0x80808080u) == 0)
+		return 16;
+
+	for (i = 0; p[i] < 0x80; i++);
+	return i;
+
+#endif
+}
+
+/* The output needs room for 'len' + 16 units. Returns the number of units written. */
+static sint utf8_transcode_utf16(const char* str, sint len, u16* out)
+{
+	const u8* p = (const u8*)str;
+	const u8* end = p + len;
+	u16* o = out;
+	s32 symbol;
+
+	while (end - p >= 16)
+	{
+		sint ascii = utf8_ascii_block(p);
+
+		/* Widen the whole block, only the ASCII prefix is kept. */
+#if defined(PLATFORM_HAS_SSE2)
+		__m128i v = _mm_loadu_si128((const __m128i*)p);
+		_mm_storeu_si128((__m128i*)o, _mm_unpacklo_epi8(v, _mm_setzero_si128()));
+		_mm_storeu_si128((__m128i*)(o + 8), _mm_unpackhi_epi8(v, _mm_setzero_si128()));
+#elif defined(PLATFORM_HAS_NEON)
+		uint8x16_t v = vld1q_u8(p);
+		vst1q_u16(o, vmovl_u8(vget_low_u8(v)));
+		vst1q_u16(o + 8, vmovl_u8(vget_high_u8(v)));
+#else
+		sint i;
+		for (i = 0; i < ascii; i++)
+			o[i] = p[i];
+#endif
+
+		p += ascii;
+		o += ascii;
+
+		/* Stay scalar for the whole run of multibyte sequences. */
+		while ((p < end) && (*p >= 0x80))
+		{
+			p += utf8_decode_checked(p, end, &symbol);
+			o += utf16_encode(o, symbol);
+		}
+	}
+
+	while (p < end)
+	{
+		p += utf8_decode_checked(p, end, &symbol);
+		o += utf16_encode(o, symbol);
+	}
+
+	return (sint)(o - out);
+}
+
+/* The output needs room for 'len' + 16 units. Returns the number of units written. */
+static sint utf8_transcode_utf32(const char* str, sint len, s32* out)
+{
+	const u8* p = (const u8*)str;
+	const u8* end = p + len;
+	s32* o = out;
+
+	while (end - p >= 16)
+	{
+		sint ascii = utf8_ascii_block(p);
+
+#if defined(PLATFORM_HAS_SSE2)
+		__m128i zero = _mm_setzero_si128();
+		__m128i v = _mm_loadu_si128((const __m128i*)p);
+		__m128i lo = _mm_unpacklo_epi8(v, zero);
+		__m128i hi = _mm_unpackhi_epi8(v, zero);
+		_mm_storeu_si128((__m128i*)o, _mm_unpacklo_epi16(lo, zero));
+		_mm_storeu_si128((__m128i*)(o + 4), _mm_unpackhi_epi16(lo, zero));
+		_mm_storeu_si128((__m128i*)(o + 8), _mm_unpacklo_epi16(hi, zero));
+		_mm_storeu_si128((__m128i*)(o + 12), _mm_unpackhi_epi16(hi, zero));
+#elif defined(PLATFORM_HAS_NEON)
+		uint8x16_t v = vld1q_u8(p);
+		uint16x8_t lo = vmovl_u8(vget_low_u8(v));
+		uint16x8_t hi = vmovl_u8(vget_high_u8(v));
+		vst1q_u32((u32*)o, vmovl_u16(vget_low_u16(lo)));
+		vst1q_u32((u32*)o + 4, vmovl_u16(vget_high_u16(lo)));
+		vst1q_u32((u32*)o + 8, vmovl_u16(vget_low_u16(hi)));
+		vst1q_u32((u32*)o + 12, vmovl_u16(vget_high_u16(hi)));
+#else
+		sint i;
+		for (i = 0; i < ascii; i++)
+			o[i] = p[i];
+#endif
+
+		p += ascii;
+		o += ascii;
+
+		while ((p < end) && (*p >= 0x80))
+			p += utf8_decode_checked(p, end, o++);
+	}
+
+	while (p < end)
+		p += utf8_decode_checked(p, end, o++);
+
+	return (sint)(o - out);
+}
+
+/* The output needs room for 3 * 'len' + 8 bytes. Lone surrogates become U+FFFD. Returns the
+ * number of bytes written. */
+static sint utf16_transcode_utf8(const u16* str, sint len, char* out)
+{
+	const u16* p = str;
+	const u16* end = p + len;
+	char* o = out;
+
+	while (p < end)
+	{
+		s32 symbol;
+
+#if defined(PLATFORM_HAS_SSE2)
+		/* 8 ASCII units at a time. */
+		while (end - p >= 8)
+		{
+			__m128i v = _mm_loadu_si128((const __m128i*)p);
+			__m128i high = _mm_and_si128(v, _mm_set1_epi16((short)0xFF80));
+
+			if (_mm_movemask_epi8(_mm_cmpeq_epi16(high, _mm_setzero_si128())) != 0xFFFF)
+				break;
+
+			_mm_storel_epi64((__m128i*)o, _mm_packus_epi16(v, v));
+			p += 8;
+			o += 8;
+		}
+
+		if (p == end)
+			break;
+#elif defined(PLATFORM_HAS_NEON)
+		while (end - p >= 8)
+		{
+			uint16x8_t v = vld1q_u16(p);
+
+			if (vmaxvq_u16(v) >= 0x80)
+				break;
+
+			vst1_u8((u8*)o, vmovn_u16(v));
+			p += 8;
+			o += 8;
+		}
+
+		if (p == end)
+			break;
+#endif
+
+		symbol = *p++;
+
+		if ((symbol >= 0xD800) & (symbol <= 0xDFFF))
+		{
+			if ((symbol <= 0xDBFF) && (p < end) && ((*p >= 0xDC00) & (*p <= 0xDFFF)))
+				symbol = (((symbol & 0x3FF) << 10) | (*p++ & 0x3FF)) + 0x10000;
+			else
+				symbol = 0xFFFD;
+		}
+
+		o += utf8_encode(o, symbol);
+	}
+
+	return (sint)(o - out);
+}
+
+static sint utf16_units(const u16* str)
+{
+	sint len = 0;
+
+#if defined(PLATFORM_HAS_SSE2)
+	/* Aligned loads never cross into an unmapped page past the terminator. */
+	for (; ((uptr)(str + len) & 15) != 0; len++)
+	{
+		if (str[len] == 0)
+			return len;
+	}
+
+	for (;; len += 8)
+	{
+		__m128i v = _mm_load_si128((const __m128i*)(str + len));
+		uint mask = (uint)_mm_movemask_epi8(_mm_cmpeq_epi16(v, _mm_setzero_si128()));
+
+		if (mask != 0)
+			return len + ctz(mask) / 2;
+	}
+
+#else
+	for (; str[len] != 0; len++);
+	return len;
+
+#endif
+}
+
+
+
 /*************************************************************************************************/
 
 string string_init(sint len)
 {
-	string str = { NULL, 0, 0 };
+	return string_init_alloc(len, NULL);
+}
+
+string string_init_alloc(sint len, allocator* alloc)
+{
+	string str;
+
+	str.buf.small[0] = 0;
+	str.len = 0;
+	str.cap = 0;
+	str.shrink = CONTAINER_SHRINK_DEFAULT;
+	str.alloc = alloc;
+
 	string_reserve(&str, len);
 	return str;
 }
 
-void destroy_string(string* str)
+void string_destroy(string* str)
 {
-	free(str->data);
+	if (str->cap != 0)
+		mem_free(str->alloc, str->buf.data, (uptr)str->cap);
 }
 
 void string_reserve(string* str, sint len)
 {
-	if (str->cap <= len)
+	if ((str->cap == 0 ? STRING_SMALL_CAP : str->cap) <= len)
 	{
 		char* new_data;
+		sint cap;
+
+		cap = get_container_capacity(len + 1);
+
+		if (str->cap != 0)
+		{
+			new_data = mem_realloc(str->alloc, str->buf.data, (uptr)str->cap, (uptr)cap);
+		}
+		else
+		{
+			new_data = mem_alloc(str->alloc, (uptr)cap);
+			memcpy(new_data, str->buf.small, (uptr)str->len + 1);
+		}
 
-		str->cap = get_container_capacity(len + 1);
-		new_data = (char*)malloc(str->cap);
-		memcpy(new_data, str->data, str->len);
-		new_data[str->len] = 0;
-		destroy_string(str);
-		str->data = new_data;
+		str->buf.data = new_data;
+		str->cap = cap;
 	}
 }
 
 void string_trim(string* str)
 {
-	if ((str->cap / 4) > str->len)
+	sint cap;
+
+	if ((str->cap != 0) && (get_container_capacity(str->len * 2) < str->cap))
 	{
-		str->cap = get_container_capacity(str->len * 2);
-		str->data = realloc(str->data, (uptr)str->cap);
+		if (str->len < STRING_SMALL_CAP)
+		{
+			/* Move back into the struct. */
+			char* data = str->buf.data;
+
+			memcpy(str->buf.small, data, (uptr)str->len + 1);
+			mem_free(str->alloc, data, (uptr)str->cap);
+			str->cap = 0;
+			return;
+		}
+
+		cap = get_container_capacity(str->len * 2);
+		str->buf.data = mem_realloc(str->alloc, str->buf.data, (uptr)str->cap, (uptr)cap);
+		str->cap = cap;
 	}
 }
 
 char* string_get(string* str, sint idx)
 {
-	return str->data + idx;
+	return (str->cap == 0 ? str->buf.small : str->buf.data) + idx;
 }
 
 void string_insert(string* str, char* seq, sint len, sint idx)
 {
+	char* data;
+
 	string_reserve(str, str->len + len);
-	memmove(str->data + idx + len, str->data + idx, str->len - idx);
-	memcpy(str->data + idx, seq, len);
+	data = string_get(str, 0);
+	memmove(data + idx + len, data + idx, str->len - idx);
+	memcpy(data + idx, seq, len);
 	str->len += len;
-	str->data[str->len] = 0;
+	data[str->len] = 0;
 }
 
 void string_append(string* str, char* seq, sint len)
@@ -170,69 +493,62 @@ void string_append(string* str, char* seq, sint len)
 
 void string_erase(string* str, sint idx, sint len)
 {
+	char* data;
+
 	if ((idx + len) > str->len)
 		return;
 
-	memmove(str->data + idx, str->data + idx + len, str->len - idx - len);
+	data = string_get(str, 0);
+	memmove(data + idx, data + idx + len, str->len - idx - len);
 	str->len -= len;
-	str->data[str->len] = 0;
-	string_trim(str);
+	data[str->len] = 0;
+
+	if (CONTAINER_SHOULD_SHRINK(str))
+		string_trim(str);
 }
 
 u16* string_to_utf16(string* str, sint* out_len)
 {
-	sint x, y, size;
-	s32 symbol;
+	sint size;
 	u16* string;
 
-	size = utf16_len_utf8(str->data);
-	string = malloc(sizeof(u16) * (size + 1));
+	/* A UTF-8 string never has more UTF-16 units than bytes. */
+	string = malloc(sizeof(u16) * ((uptr)str->len + 16));
+	size = utf8_transcode_utf16(string_get(str, 0), str->len, string);
 	string[size] = 0;
-	
+
 	if (out_len != NULL)
 		*out_len = size;
 
-	for (x = 0, y = 0; str->data[x] != 0;)
-		x += utf8_decode(str->data + x, &symbol),
-		y += utf16_encode(string + y, symbol);
-
 	return string;
 }
 
 s32* string_to_utf32(string* str, sint* out_len)
 {
-	sint x, y, size;
-	s32 symbol;
+	sint size;
 	s32* string;
 
-	size = utf32_len_utf8(str->data);
-	string = malloc(sizeof(s32) * (size + 1));
+	string = malloc(sizeof(s32) * ((uptr)str->len + 16));
+	size = utf8_transcode_utf32(string_get(str, 0), str->len, string);
 	string[size] = 0;
-	
+
 	if (out_len != NULL)
 		*out_len = size;
 
-	for (x = 0, y = 0; str->data[x] != 0;)
-		x += utf8_decode(str->data + x, &symbol),
-		string[y++] = symbol;
-
 	return string;
 }
 
 string string_from_utf16(u16* str)
 {
-	sint x, y, size;
-	s32 symbol;
+	sint len;
 	string string;
 
-	size = utf8_len_utf16(str);
-	string = string_init(size);
-	string.len = size;
-	string.data[size] = 0;
-
-	for (x = 0, y = 0; str[x] != 0;)
-		x += utf16_decode(str + x, &symbol),
-		y += utf8_encode(string.data + y, symbol);
+	/* A UTF-16 unit never needs more than 3 bytes. */
+	len = utf16_units(str);
+	string = string_init(len * 3 + 8);
+	string.len = utf16_transcode_utf8(str, len, string_get(&string, 0));
+	*string_get(&string, string.len) = 0;
+	string_trim(&string);
 
 	return string;
 }
@@ -246,21 +562,25 @@ string string_from_utf32(s32* str)
 	size = utf8_len_utf32(str);
 	string = string_init(size);
 	string.len = size;
-	string.data[size] = 0;
+	*string_get(&string, size) = 0;
 
 	for (x = 0, y = 0; str[x] != 0;)
-		symbol = str[x++], y += utf8_encode(string.data + y, symbol);
+		symbol = str[x++], y += utf8_encode(string_get(&string, y), symbol);
 
 	return string;
 }
 
 sint string_cmp(string* a, string* b)
 {
-	return strcmp(a->data, b->data);
+	return strcmp(string_get(a, 0), string_get(b, 0));
 }
 
 sint string_hash(const char* string)
 {
+#if defined(PLATFORM_HAS_I64)
+	return (sint)hash_cstr(string, 0);
+
+#else
 	sint multiplier = 31;
 	sint i, m, hash = 0;
 
@@ -270,7 +590,16 @@ sint string_hash(const char* string)
 	}
 
 	return hash;
+
+#endif
+}
+
+#if defined(PLATFORM_HAS_I64)
+u64 string_hash_seeded(string* str, u64 seed)
+{
+	return hash_bytes(string_get(str, 0), str->len, seed);
 }
+#endif
 
 /* UTF-8
  * 01111111                             7-bit ASCII characters
@@ -391,54 +720,46 @@ sint utf8_decode(const char* str, s32* out_symbol)
 		*out_symbol = str[0];
 		return 1;
 	case 2:
-		*out_symbol = ((0x1F & str[0]) << 6) | (0x1F & str[1]);
+		*out_symbol = ((0x1F & str[0]) << 6) | (0x3F & str[1]);
 		return 2;
 	case 3:
-		*out_symbol = ((0xF & str[0]) << 12) | ((0x1F & str[1]) << 6) | (0x1F & str[2]);
+		*out_symbol = ((0xF & str[0]) << 12) | ((0x3F & str[1]) << 6) | (0x3F & str[2]);
 		return 3;
 	case 4:
-		*out_symbol = ((0x7 & str[0]) << 18) | ((0x1F & str[1]) << 12) | ((0x1F & str[2]) << 6) | (0x1F & str[3]);
+		*out_symbol = ((0x7 & str[0]) << 18) | ((0x3F & str[1]) << 12) | ((0x3F & str[2]) << 6) | (0x3F & str[3]);
 		return 4;
 	}
 }
 
 u16* utf8_to_utf16(const char* str, sint* out_len)
 {
-	sint x, y, size;
-	s32 symbol;
+	sint len, size;
 	u16* string;
 
-	size = utf16_len_utf8(str);
-	string = malloc(sizeof(u16) * (size + 1));
+	len = (sint)strlen(str);
+	string = malloc(sizeof(u16) * ((uptr)len + 16));
+	size = utf8_transcode_utf16(str, len, string);
 	string[size] = 0;
-	
+
 	if (out_len != NULL)
 		*out_len = size;
 
-	for (x = 0, y = 0; str[x] != 0;)
-		x += utf8_decode(str + x, &symbol),
-		y += utf16_encode(string + y, symbol);
-
 	return string;
 }
 
 s32* utf8_to_utf32(const char* str, sint* out_len)
 {
-	sint x, y, size;
-	s32 symbol;
+	sint len, size;
 	s32* string;
 
-	size = utf32_len_utf8(str);
-	string = malloc(sizeof(s32) * (size + 1));
+	len = (sint)strlen(str);
+	string = malloc(sizeof(s32) * ((uptr)len + 16));
+	size = utf8_transcode_utf32(str, len, string);
 	string[size] = 0;
 
 	if (out_len != NULL)
 		*out_len = size;
 
-	for (x = 0, y = 0; str[x] != 0;)
-		x += utf8_decode(str + x, &symbol),
-		string[y++] = symbol;
-
 	return string;
 }
 
@@ -510,7 +831,7 @@ sint utf32_len_utf8(const char* str)
 	if (str == NULL)
 		return 0;
 
-	for (i = 0, len = 0; str[i] != 0; i += utf8_symbol_size(str[len]), i++);
+	for (i = 0, len = 0; str[i] != 0; i += utf8_symbol_size(str[i]), len++);
 	return len;
 }
 
@@ -520,39 +841,35 @@ sint utf32_len_utf8(const char* str)
 
 flat_map flat_map_init(sint size, sint len, cmpfunc cmp)
 {
-	flat_map map = { NULL, size, 0, 0, cmp };
+	return flat_map_init_alloc(size, len, cmp, NULL);
+}
+
+flat_map flat_map_init_alloc(sint size, sint len, cmpfunc cmp, allocator* alloc)
+{
+	flat_map map = { NULL, size, 0, 0, CONTAINER_SHRINK_DEFAULT, alloc, cmp, 0, 0, 0 };
 	flat_map_reserve(&map, len);
 	return map;
 }
 
 void flat_map_destroy(flat_map* map)
 {
-	free(map->buckets);
+	vector_destroy((vector*)map);
 }
 
 void flat_map_reserve(flat_map* map, sint len)
 {
-	if (map->cap < len)
-	{
-		void* new_data;
-
-		len = get_container_capacity(len);
-		new_data = malloc((uptr)len * map->bucket_size);
-		map->cap = len;
+	if (map->frozen)
+		flat_map_thaw(map);
 
-		memcpy(new_data, map->buckets, (uptr)map->len * map->bucket_size);
-		flat_map_destroy(map);
-		map->buckets = new_data;
-	}
+	vector_reserve((vector*)map, len);
 }
 
 void flat_map_trim(flat_map* map)
 {
-	if ((map->cap / 4) > map->len)
-	{
-		map->cap = get_container_capacity(map->len * 2);
-		map->buckets = realloc(map->buckets, (uptr)map->cap * map->bucket_size);
-	}
+	if (map->frozen)
+		flat_map_thaw(map);
+
+	vector_trim((vector*)map);
 }
 
 void* flat_map_get_index(flat_map* map, void* bucket, sint* out_index)
@@ -605,6 +922,10 @@ void* flat_map_get_index(flat_map* map, void* bucket, sint* out_index)
 void* flat_map_get(flat_map* map, void* bucket)
 {
 	sint index;
+
+	if (map->frozen)
+		return flat_map_get_frozen(map, bucket);
+
 	return flat_map_get_index(map, bucket, &index);
 }
 
@@ -613,6 +934,9 @@ void* flat_map_push(flat_map* map, void* bucket)
 	sint index;
 	void* _bucket;
 
+	if (map->frozen)
+		flat_map_thaw(map);
+
 	_bucket = flat_map_get_index(map, bucket, &index);
 
 	if (_bucket != NULL)
@@ -627,6 +951,9 @@ sint flat_map_pop(flat_map* map, void* bucket, void* out_bucket)
 	sint index;
 	void* _bucket;
 
+	if (map->frozen)
+		flat_map_thaw(map);
+
 	_bucket = flat_map_get_index(map, bucket, &index);
 
 	if (_bucket != NULL)
@@ -639,420 +966,3650 @@ sint flat_map_pop(flat_map* map, void* bucket, void* out_bucket)
 	return INVALID_INDEX;
 }
 
+/* The frozen layout stores the sorted buckets as an implicit binary tree in breadth first order,
+ * the children of slot k are 2k and 2k + 1 and slot 0 is unused. The top levels share cache
+ * lines and the 16 descendants four levels down are contiguous, so they can be prefetched. */
 
-
-/*************************************************************************************************/
-
-flat_hashmap flat_hashmap_init(sint size, sint len, hashfunc hash, cmpfunc cmp)
+static sint eytzinger_first(sint len)
 {
-	sint sz, cap;
-	flat_hashmap map;
-
-	cap = get_container_capacity(len);
-	sz = (cap + 2) * size;
+	sint k;
 
-	map.buckets = malloc(sz + cap);
-	map.info = (u8*)map.buckets + sz;
-	map.bucket_size = size;
-	map.cap = cap;
-	map.len = 0;
-	map.hash = hash;
-	map.cmp = cmp;
+	if (len == 0)
+		return INVALID_INDEX;
 
-	memset(map.info, U8_MAX, map.cap);
-	return map;
+	for (k = 1; (k * 2) <= len; k *= 2);
+	return k;
 }
 
-void flat_hashmap_destroy(flat_hashmap* map)
+/* In-order successor of slot 'k'. */
+static sint eytzinger_next(sint k, sint len)
 {
-	free(map->buckets);
+	if ((k * 2 + 1) <= len)
+	{
+		for (k = k * 2 + 1; (k * 2) <= len; k *= 2);
+		return k;
+	}
+
+	/* Climb while 'k' is a right child, then once more to the parent 'k' is left of. */
+	k >>= ctz(~(uint)k) + 1;
+	return k == 0 ? INVALID_INDEX : k;
 }
 
-void flat_hashmap_reserve(flat_hashmap* map, sint len)
+void flat_map_freeze(flat_map* map)
 {
-	if (len > (map->cap - (map->cap / 4)))
-	{
-		flat_hashmap new_map;
-		sint i;
+	u8* tree;
+	sint i, k;
 
-		new_map = flat_hashmap_init(map->bucket_size, len * 2, map->hash, map->cmp);
+	if (map->frozen)
+		return;
 
-		for (i = 0; i < map->cap; i++)
-		{
-			if (map->info[i] != U8_MAX)
-			{
-				void* _bucket = (void*)((uptr)map->buckets + ((uptr)map->bucket_size * i));
-				flat_hashmap_push(&new_map, _bucket);
-			}
-		}
+	tree = mem_alloc(map->alloc, (uptr)(map->len + 1) * map->bucket_size);
 
-		flat_hashmap_destroy(map);
-		*map = new_map;
-	}
+	for (i = 0, k = eytzinger_first(map->len); k != INVALID_INDEX; i++, k = eytzinger_next(k, map->len))
+		memcpy(tree + (uptr)k * map->bucket_size, (u8*)map->buckets + (uptr)i * map->bucket_size,
+			map->bucket_size);
+
+	flat_map_destroy(map);
+	map->buckets = tree;
+	map->cap = map->len + 1;
+	map->frozen = 1;
 }
 
-void flat_hashmap_trim(flat_hashmap* map)
+void flat_map_thaw(flat_map* map)
 {
-	if ((map->cap - (map->cap - (map->cap / 4))) > map->len)
-	{
-		flat_hashmap new_map;
-		sint i;
+	u8* sorted;
+	sint i, k, cap;
 
-		new_map = flat_hashmap_init(map->bucket_size, map->len, map->hash, map->cmp);
+	if (!map->frozen)
+		return;
 
-		for (i = 0; i < map->cap; i++)
-		{
-			if (map->info[i] != U8_MAX)
-			{
-				void* _bucket = (void*)((uptr)map->buckets + ((uptr)map->bucket_size * i));
-				flat_hashmap_push(&new_map, _bucket);
-			}
-		}
+	cap = get_container_capacity(map->len);
+	sorted = mem_alloc(map->alloc, (uptr)cap * map->bucket_size);
 
-		flat_hashmap_destroy(map);
-		*map = new_map;
-	}
+	for (i = 0, k = eytzinger_first(map->len); k != INVALID_INDEX; i++, k = eytzinger_next(k, map->len))
+		memcpy(sorted + (uptr)i * map->bucket_size, (u8*)map->buckets + (uptr)k * map->bucket_size,
+			map->bucket_size);
+
+	flat_map_destroy(map);
+	map->buckets = sorted;
+	map->cap = cap;
+	map->frozen = 0;
 }
 
-void* flat_hashmap_get_index(flat_hashmap* map, sint hash, void* bucket, sint* out_index)
+void* flat_map_get_frozen(flat_map* map, void* bucket)
 {
-	sint mask, idx, distance;
+	u8* tree;
+	sint k, len, size;
 
-	mask = map->cap - 1;
-	idx = hash & mask;
-	distance = 0;
+	tree = map->buckets;
+	len = map->len;
+	size = map->bucket_size;
 
-	for (;; idx = (idx + 1) & mask, distance++)
+	/* Branchless descent to the lower bound, the loop exit is the only branch. The 16 slots four
+	 * levels down are fetched ahead, their first and last line cover buckets up to 8 bytes. */
+	for (k = 1; k <= len;)
 	{
-		void* _bucket;
-		sint _distance;
+		u8* ahead = tree + (uptr)k * 16 * size;
 
-		_bucket = (void*)((uptr)map->buckets + ((uptr)idx * map->bucket_size));
-		_distance = map->info[idx];
-
-		if ((_distance == U8_MAX) | (distance > _distance))
-		{
-			*out_index = idx;
-			return NULL;
-		}
-		else if (map->cmp(bucket, _bucket) == 0)
-		{
-			*out_index = idx;
-			return _bucket;
-		}
+		prefetch(ahead);
+		prefetch(ahead + 15 * size);
+		k = (k * 2) + (map->cmp(bucket, tree + (uptr)k * size) > 0);
 	}
+
+	/* Undo the trailing right turns and the final left turn. */
+	k >>= ctz(~(uint)k) + 1;
+
+	if ((k == 0) || (map->cmp(bucket, tree + (uptr)k * size) != 0))
+		return NULL;
+
+	return tree + (uptr)k * size;
 }
 
-void* flat_hashmap_get(flat_hashmap* map, void* bucket)
+sint flat_map_begin(flat_map* map)
 {
-	sint idx;
-	return flat_hashmap_get_index(map, map->hash(bucket), bucket, &idx);
+	if (map->frozen)
+		return eytzinger_first(map->len);
+
+	return map->len == 0 ? INVALID_INDEX : 0;
 }
 
-void* flat_hashmap_push(flat_hashmap* map, void* bucket)
+sint flat_map_next(flat_map* map, sint pos)
 {
-	sint mask, hash, idx, distance;
-	void* _bucket;
+	if (map->frozen)
+		return eytzinger_next(pos, map->len);
+
+	return pos + 1 < map->len ? pos + 1 : INVALID_INDEX;
+}
+
+void* flat_map_at(flat_map* map, sint pos)
+{
+	return (u8*)map->buckets + (uptr)pos * map->bucket_size;
+}
+
+void flat_map_set_key(flat_map* map, sint key_offset, sint key_type)
+{
+	map->key_offset = key_offset;
+	map->key_type = key_type;
+}
+
+/* Flips float bits so that they order as unsigned integers, the order radix_sort uses. NaNs
+ * order by their bits and -0 before 0. */
+static u32 float_order_bits(u32 bits)
+{
+	return (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+}
+
+/* Compares two buckets through the declared key, or 'cmp' without one. */
+static sint flat_map_compare(flat_map* map, void* a, void* b)
+{
+	u8* ka = (u8*)a + map->key_offset;
+	u8* kb = (u8*)b + map->key_offset;
+
+	switch (map->key_type)
+	{
+	case RADIX_KEY_U32:
+	{
+		u32 x, y;
+
+		memcpy(&x, ka, sizeof(u32));
+		memcpy(&y, kb, sizeof(u32));
+		return (x > y) - (x < y);
+	}
+
+	case RADIX_KEY_F32:
+	{
+		u32 x, y;
+
+		/* The bits radix sort orders by, so NaNs and -0 land where the sort put them. */
+		memcpy(&x, ka, sizeof(u32));
+		memcpy(&y, kb, sizeof(u32));
+		x = float_order_bits(x);
+		y = float_order_bits(y);
+		return (x > y) - (x < y);
+	}
+
+	case RADIX_KEY_U64:
+	{
+		u32 x[2], y[2];
+
+		/* Little endian halves, compared high first. */
+		memcpy(x, ka, sizeof(x));
+		memcpy(y, kb, sizeof(y));
+
+		if (x[1] != y[1])
+			return (x[1] > y[1]) - (x[1] < y[1]);
+
+		return (x[0] > y[0]) - (x[0] < y[0]);
+	}
+
+	default:
+		return map->cmp(a, b);
+	}
+}
+
+/* Stable bottom-up merge sort of 'count' buckets through 'cmp', used without a declared key. */
+static void flat_map_sort(flat_map* map, u8* buckets, sint count)
+{
+	u8* src, *dst, *tmp, *buffer;
+	sint size, width, lo;
+
+	size = map->bucket_size;
+
+	if (count < 2)
+		return;
+
+	buffer = mem_alloc(map->alloc, (uptr)count * size);
+	src = buckets;
+	dst = buffer;
+
+	for (width = 1; width < count; width *= 2)
+	{
+		for (lo = 0; lo < count; lo += width * 2)
+		{
+			sint mid, hi, i, j, k;
+
+			mid = lo + width < count ? lo + width : count;
+			hi = lo + width * 2 < count ? lo + width * 2 : count;
+
+			for (i = lo, j = mid, k = lo; k < hi; k++)
+			{
+				u8* next;
+
+				if ((i < mid) && ((j >= hi) || (map->cmp(src + (uptr)j * size, src + (uptr)i * size) >= 0)))
+					next = src + (uptr)i++ * size;
+				else
+					next = src + (uptr)j++ * size;
+
+				memcpy(dst + (uptr)k * size, next, size);
+			}
+		}
+
+		tmp = src;
+		src = dst;
+		dst = tmp;
+	}
+
+	if (src != buckets)
+		memcpy(buckets, src, (uptr)count * size);
+
+	mem_free(map->alloc, buffer, (uptr)count * size);
+}
+
+void flat_map_build(flat_map* map, void* buckets, sint count)
+{
+	u8* data;
+	sint i, len, size;
+
+	flat_map_thaw(map);
+	map->len = 0;
+
+	if (count == 0)
+		return;
+
+	vector_reserve((vector*)map, count);
+
+	size = map->bucket_size;
+	data = map->buckets;
+	memcpy(data, buckets, (uptr)count * size);
+
+	if (map->key_type != 0)
+		radix_sort(data, size, count, map->key_offset, map->key_type, map->alloc);
+	else
+		flat_map_sort(map, data, count);
+
+	/* Both sorts are stable, so the first of a run of equal buckets is the one pushed first. */
+	for (i = 1, len = 1; i < count; i++)
+	{
+		u8* bucket = data + (uptr)i * size;
+
+		if (flat_map_compare(map, data + (uptr)(len - 1) * size, bucket) == 0)
+			continue;
+
+		if (len != i)
+			memcpy(data + (uptr)len * size, bucket, size);
+
+		len++;
+	}
+
+	map->len = len;
+}
+
+void flat_map_push_sorted(flat_map* map, void* buckets, sint count)
+{
+	u8* data, *batch, *last;
+	sint i, j, w, size;
+
+	if (count == 0)
+		return;
+
+	flat_map_thaw(map);
+	vector_reserve((vector*)map, map->len + count);
+
+	size = map->bucket_size;
+	data = map->buckets;
+	batch = buckets;
+	last = NULL;
+
+	/* Merge from the back, so the existing buckets are only moved once. On equal keys the batch
+	 * bucket goes first and is overwritten by the bucket in front of it, which leaves the existing
+	 * or earliest one. */
+	for (i = map->len - 1, j = count - 1, w = map->len + count; (i >= 0) | (j >= 0);)
+	{
+		u8* next;
+
+		if ((j >= 0) && ((i < 0) || (flat_map_compare(map, batch + (uptr)j * size, data + (uptr)i * size) >= 0)))
+			next = batch + (uptr)j-- * size;
+		else
+			next = data + (uptr)i-- * size;
+
+		if ((last == NULL) || (flat_map_compare(map, next, last) != 0))
+			last = data + (uptr)--w * size;
+
+		if (next != last)
+			memcpy(last, next, size);
+	}
+
+	map->len = map->len + count - w;
+	memmove(data, data + (uptr)w * size, (uptr)map->len * size);
+}
+
+#define FLAT_MAP_UNION 0
+#define FLAT_MAP_INTERSECTION 1
+#define FLAT_MAP_DIFFERENCE 2
+
+/* Intersection or difference of two sorted u32 arrays, 4 x 4 keys are compared at once. Returns
+ * the number of keys written to 'out'. */
+static sint flat_map_combine_u32(const u32* a, sint a_len, const u32* b, sint b_len, u32* out, sint op)
+{
+	sint i, j, n, block;
+	uint found;
+
+	i = 0;
+	j = 0;
+	n = 0;
+	found = 0;
+
+#if defined(PLATFORM_HAS_SSE2) || defined(PLATFORM_HAS_NEON)
+	while ((i + 4 <= a_len) & (j + 4 <= b_len))
+	{
+		u32 a_max, b_max;
+
+		/* Bit k is set if a[i + k] equals any of b[j .. j + 3]. */
+#if defined(PLATFORM_HAS_SSE2)
+		__m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+		__m128i vb = _mm_loadu_si128((const __m128i*)(b + j));
+		__m128i eq = _mm_or_si128(
+			_mm_or_si128(_mm_cmpeq_epi32(va, vb), _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, 0x39))),
+			_mm_or_si128(_mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, 0x4E)), _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, 0x93))));
+		found |= (uint)_mm_movemask_ps(_mm_castsi128_ps(eq));
+#else
+		static const u32 bits[4] = { 1, 2, 4, 8 };
+		uint32x4_t va = vld1q_u32(a + i);
+		uint32x4_t vb = vld1q_u32(b + j);
+		uint32x4_t eq = vorrq_u32(
+			vorrq_u32(vceqq_u32(va, vb), vceqq_u32(va, vextq_u32(vb, vb, 1))),
+			vorrq_u32(vceqq_u32(va, vextq_u32(vb, vb, 2)), vceqq_u32(va, vextq_u32(vb, vb, 3))));
+		found |= vaddvq_u32(vandq_u32(eq, vld1q_u32(bits)));
+#endif
+
+		a_max = a[i + 3];
+		b_max = b[j + 3];
+
+		if (b_max <= a_max)
+			j += 4;
+
+		/* The block of 'a' is done once no later block of 'b' can match it. */
+		if (a_max <= b_max)
+		{
+			uint keep = op == FLAT_MAP_INTERSECTION ? found : ~found & 0xF;
+
+			for (; keep != 0; keep &= keep - 1)
+				out[n++] = a[i + ctz(keep)];
+
+			i += 4;
+			found = 0;
+		}
+	}
+#endif
+
+	/* The rest key by key, 'found' carries over for the current block of 'a'. */
+	for (block = i; i < a_len; i++)
+	{
+		sint match = i < block + 4 ? (found >> (i - block)) & 1 : 0;
+
+		while ((j < b_len) && (b[j] < a[i]))
+			j++;
+
+		match |= (j < b_len) && (b[j] == a[i]);
+
+		if (match == (op == FLAT_MAP_INTERSECTION))
+			out[n++] = a[i];
+	}
+
+	return n;
+}
+
+static void flat_map_combine(flat_map* dst, flat_map* a, flat_map* b, sint op)
+{
+	u8* out, *pa, *pb, *ea, *eb;
+	sint size;
+
+	flat_map_thaw(dst);
+	flat_map_thaw(a);
+	flat_map_thaw(b);
+
+	size = a->bucket_size;
+	dst->len = 0;
+	vector_reserve((vector*)dst, op == FLAT_MAP_UNION ? a->len + b->len : a->len);
+
+	if ((op != FLAT_MAP_UNION) && (size == sizeof(u32)) && (a->key_type == RADIX_KEY_U32))
+	{
+		dst->len = flat_map_combine_u32(a->buckets, a->len, b->buckets, b->len, dst->buckets, op);
+		return;
+	}
+
+	out = dst->buckets;
+	pa = a->buckets;
+	pb = b->buckets;
+	ea = pa + (uptr)a->len * size;
+	eb = pb + (uptr)b->len * size;
+
+	while ((pa < ea) & (pb < eb))
+	{
+		sint result = flat_map_compare(a, pa, pb);
+
+		if (result < 0)
+		{
+			if (op != FLAT_MAP_INTERSECTION)
+			{
+				memcpy(out, pa, size);
+				out += size;
+			}
+
+			pa += size;
+		}
+		else if (result > 0)
+		{
+			if (op == FLAT_MAP_UNION)
+			{
+				memcpy(out, pb, size);
+				out += size;
+			}
+
+			pb += size;
+		}
+		else
+		{
+			if (op != FLAT_MAP_DIFFERENCE)
+			{
+				memcpy(out, pa, size);
+				out += size;
+			}
+
+			pa += size;
+			pb += size;
+		}
+	}
+
+	if ((pa < ea) && (op != FLAT_MAP_INTERSECTION))
+	{
+		memcpy(out, pa, ea - pa);
+		out += ea - pa;
+	}
+
+	if ((pb < eb) && (op == FLAT_MAP_UNION))
+	{
+		memcpy(out, pb, eb - pb);
+		out += eb - pb;
+	}
+
+	dst->len = (sint)((uptr)(out - (u8*)dst->buckets) / size);
+}
+
+void flat_map_union(flat_map* dst, flat_map* a, flat_map* b)
+{
+	flat_map_combine(dst, a, b, FLAT_MAP_UNION);
+}
+
+void flat_map_intersection(flat_map* dst, flat_map* a, flat_map* b)
+{
+	flat_map_combine(dst, a, b, FLAT_MAP_INTERSECTION);
+}
+
+void flat_map_difference(flat_map* dst, flat_map* a, flat_map* b)
+{
+	flat_map_combine(dst, a, b, FLAT_MAP_DIFFERENCE);
+}
+
+
+
+/*************************************************************************************************/
+
+/* Buckets and info share one allocation, returns the offset of the info words. */
+static uptr flat_hashmap_info_offset(sint size, sint cap)
+{
+	uptr sz, rest;
+
+	sz = (uptr)(cap + 2) * size;
+	rest = sz % sizeof(u32);
+
+	if (rest != 0)
+		sz += sizeof(u32) - rest;
+
+	return sz;
+}
+
+flat_hashmap flat_hashmap_init(sint size, sint len, hashfunc hash, cmpfunc cmp)
+{
+	return flat_hashmap_init_alloc(size, len, hash, cmp, NULL);
+}
+
+flat_hashmap flat_hashmap_init_alloc(sint size, sint len, hashfunc hash, cmpfunc cmp, allocator* alloc)
+{
+	sint cap;
+	uptr sz;
+	flat_hashmap map;
+
+	cap = get_container_capacity(len);
+	sz = flat_hashmap_info_offset(size, cap);
+
+	map.buckets = mem_alloc(alloc, sz + (sizeof(u32) * cap));
+	map.info = (u32*)((uptr)map.buckets + sz);
+	map.bucket_size = size;
+	map.cap = cap;
+	map.len = 0;
+	map.shrink = CONTAINER_SHRINK_DEFAULT;
+	map.incremental = 0;
+	map.alloc = alloc;
+	map.hash = hash;
+	map.cmp = cmp;
+	map.migration = NULL;
+
+	memset(map.info, U8_MAX, sizeof(u32) * map.cap);
+	return map;
+}
+
+void flat_hashmap_destroy(flat_hashmap* map)
+{
+	if (map->migration != NULL)
+	{
+		flat_hashmap_destroy(&map->migration->table);
+		mem_free(map->alloc, map->migration, sizeof(flat_hashmap_migration));
+	}
+
+	mem_free(map->alloc, map->buckets,
+		flat_hashmap_info_offset(map->bucket_size, map->cap) + (sizeof(u32) * map->cap));
+}
+
+/* Insert a bucket that is known not to be in the map. */
+void flat_hashmap_insert(flat_hashmap* map, sint hash, void* bucket)
+{
+	sint mask, idx, distance;
+	u32 info;
+
+	mask = map->cap - 1;
+	idx = hash & mask;
+
+	for (distance = 0;; idx = (idx + 1) & mask, distance++)
+	{
+		void* _bucket;
+
+		_bucket = (void*)((uptr)map->buckets + ((uptr)idx * map->bucket_size));
+		info = map->info[idx];
+
+		if (info == HASHMAP_INFO_EMPTY)
+		{
+			memcpy(_bucket, bucket, map->bucket_size);
+			map->info[idx] = HASHMAP_INFO_MAKE(hash, distance);
+			map->len++;
+			return;
+		}
+		else if (distance > (sint)HASHMAP_INFO_DISTANCE(info))
+		{
+			void* tmp_one, * tmp_two;
+
+			tmp_one = (void*)((uptr)map->buckets + ((uptr)map->cap * map->bucket_size));
+			tmp_two = (void*)((uptr)tmp_one + map->bucket_size);
+
+			memcpy(tmp_one, _bucket, map->bucket_size);
+			memcpy(_bucket, bucket, map->bucket_size);
+			memcpy(tmp_two, tmp_one, map->bucket_size);
+
+			bucket = tmp_two;
+			map->info[idx] = HASHMAP_INFO_MAKE(hash, distance);
+			hash = (sint)HASHMAP_INFO_HASH(info);
+			distance = HASHMAP_INFO_DISTANCE(info);
+		}
+	}
+}
+
+void flat_hashmap_rehash_into(flat_hashmap* dst, flat_hashmap* src)
+{
+	sint i;
+
+	for (i = 0; i < src->cap; i++)
+	{
+		u32 info = src->info[i];
+
+		if (info != HASHMAP_INFO_EMPTY)
+		{
+			void* _bucket = (void*)((uptr)src->buckets + ((uptr)src->bucket_size * i));
+
+			/* The cached bits cover the home slot for up to 2^24 slots. */
+			if (dst->cap <= (1 << 24))
+				flat_hashmap_insert(dst, (sint)HASHMAP_INFO_HASH(info), _bucket);
+			else
+				flat_hashmap_insert(dst, src->hash(_bucket), _bucket);
+		}
+	}
+}
+
+void flat_hashmap_rebuild(flat_hashmap* map, sint len)
+{
+	flat_hashmap new_map;
+
+	new_map = flat_hashmap_init_alloc(map->bucket_size, len, map->hash, map->cmp, map->alloc);
+	new_map.shrink = map->shrink;
+	new_map.incremental = map->incremental;
+	flat_hashmap_rehash_into(&new_map, map);
+
+	flat_hashmap_destroy(map);
+	*map = new_map;
+}
+
+/* Move the table into a migration and continue on an empty table of 'len' capacity. The old
+ * slots are walked starting at an empty one, so erasing from the old table never shifts an entry
+ * across the boundary between migrated and remaining slots. Migrated entries stay in the old
+ * table to keep its probe sequences intact and are skipped by lookups. */
+static void flat_hashmap_begin_migration(flat_hashmap* map, sint len)
+{
+	flat_hashmap_migration* migration;
+	flat_hashmap new_map;
+	sint start;
+
+	for (start = 0; map->info[start] != HASHMAP_INFO_EMPTY; start++);
+
+	migration = mem_alloc(map->alloc, sizeof(flat_hashmap_migration));
+	migration->table = *map;
+	migration->start = start;
+	migration->done = 0;
+
+	new_map = flat_hashmap_init_alloc(map->bucket_size, len, map->hash, map->cmp, map->alloc);
+	new_map.shrink = map->shrink;
+	new_map.incremental = map->incremental;
+	new_map.len = map->len;
+	new_map.migration = migration;
+	*map = new_map;
+}
+
+void flat_hashmap_migrate(flat_hashmap* map, sint slots)
+{
+	flat_hashmap_migration* migration;
+	flat_hashmap* old;
+	sint mask;
+
+	migration = map->migration;
+
+	if (migration == NULL)
+		return;
+
+	old = &migration->table;
+	mask = old->cap - 1;
+
+	for (; (slots > 0) & (old->len > 0); slots--, migration->done++)
+	{
+		sint idx = (migration->start + migration->done) & mask;
+		u32 info = old->info[idx];
+
+		if (info != HASHMAP_INFO_EMPTY)
+		{
+			void* _bucket = (void*)((uptr)old->buckets + ((uptr)idx * old->bucket_size));
+
+			if (map->cap <= (1 << 24))
+				flat_hashmap_insert(map, (sint)HASHMAP_INFO_HASH(info), _bucket);
+			else
+				flat_hashmap_insert(map, map->hash(_bucket), _bucket);
+
+			/* The entry moved, it was counted in 'map->len' already. */
+			map->len--;
+			old->len--;
+		}
+	}
+
+	if (old->len == 0)
+	{
+		flat_hashmap_destroy(old);
+		mem_free(map->alloc, migration, sizeof(flat_hashmap_migration));
+		map->migration = NULL;
+	}
+}
+
+/* Look up a bucket that has not been migrated yet. */
+static void* flat_hashmap_get_migrating(flat_hashmap* map, sint hash, void* bucket, sint* out_index)
+{
+	flat_hashmap_migration* migration = map->migration;
+	void* _bucket;
+
+	_bucket = flat_hashmap_get_index(&migration->table, hash, bucket, out_index);
+
+	if ((_bucket != NULL) &&
+		(((*out_index - migration->start) & (migration->table.cap - 1)) < migration->done))
+		return NULL;
+
+	return _bucket;
+}
+
+static void flat_hashmap_finish_migration(flat_hashmap* map)
+{
+	if (map->migration != NULL)
+		flat_hashmap_migrate(map, map->migration->table.cap);
+}
+
+void flat_hashmap_reserve(flat_hashmap* map, sint len)
+{
+	if (len > (map->cap - (map->cap / 4)))
+	{
+		flat_hashmap_finish_migration(map);
+
+		if (map->incremental && (map->len > 0))
+			flat_hashmap_begin_migration(map, len * 2);
+		else
+			flat_hashmap_rebuild(map, len * 2);
+	}
+}
+
+/* Shrinks to a load of at most 1/2, so the next pushes do not grow the table right back. */
+void flat_hashmap_trim(flat_hashmap* map)
+{
+	flat_hashmap_finish_migration(map);
+
+	if (get_container_capacity(map->len * 2) < map->cap)
+		flat_hashmap_rebuild(map, map->len * 2);
+}
+
+void* flat_hashmap_get_index(flat_hashmap* map, sint hash, void* bucket, sint* out_index)
+{
+	sint mask, idx, distance;
+	u32 fingerprint;
+
+	mask = map->cap - 1;
+	idx = hash & mask;
+	distance = 0;
+	fingerprint = HASHMAP_INFO_HASH(HASHMAP_INFO_MAKE(hash, 0));
+
+	for (;; idx = (idx + 1) & mask, distance++)
+	{
+		void* _bucket;
+		u32 info;
+
+		info = map->info[idx];
+
+		if ((info == HASHMAP_INFO_EMPTY) | (distance > (sint)HASHMAP_INFO_DISTANCE(info)))
+		{
+			*out_index = idx;
+			return NULL;
+		}
+		else if (HASHMAP_INFO_HASH(info) == fingerprint)
+		{
+			_bucket = (void*)((uptr)map->buckets + ((uptr)idx * map->bucket_size));
+
+			if (map->cmp(bucket, _bucket) == 0)
+			{
+				*out_index = idx;
+				return _bucket;
+			}
+		}
+	}
+}
+
+void* flat_hashmap_get(flat_hashmap* map, void* bucket)
+{
+	sint hash, idx;
+	void* _bucket;
+
+	hash = map->hash(bucket);
+	_bucket = flat_hashmap_get_index(map, hash, bucket, &idx);
+
+	if ((_bucket == NULL) && (map->migration != NULL))
+		_bucket = flat_hashmap_get_migrating(map, hash, bucket, &idx);
+
+	return _bucket;
+}
+
+void* flat_hashmap_push(flat_hashmap* map, void* bucket)
+{
+	sint hash, idx;
+	void* _bucket;
 
 	flat_hashmap_reserve(map, map->len + 1);
+	flat_hashmap_migrate(map, HASHMAP_MIGRATE);
+
+	hash = map->hash(bucket);
+	_bucket = flat_hashmap_get_index(map, hash, bucket, &idx);
+
+	if ((_bucket == NULL) && (map->migration != NULL))
+		_bucket = flat_hashmap_get_migrating(map, hash, bucket, &idx);
+
+	if (_bucket != NULL)
+		return _bucket;
+
+	flat_hashmap_insert(map, hash, bucket);
+	return NULL;
+}
+
+void flat_hashmap_erase_index(flat_hashmap* map, sint idx)
+{
+	sint mask, next;
+
+	mask = map->cap - 1;
+
+	for (next = (idx + 1) & mask;; idx = next, next = (next + 1) & mask)
+	{
+		void* _bucket;
+		void* next_bucket;
+		u32 next_info;
+
+		next_info = map->info[next];
+
+		if ((next_info == HASHMAP_INFO_EMPTY) | (HASHMAP_INFO_DISTANCE(next_info) == 0))
+		{
+			map->info[idx] = HASHMAP_INFO_EMPTY;
+			map->len--;
+			break;
+		}
+
+		_bucket = (void*)((uptr)map->buckets + ((uptr)idx * map->bucket_size));
+		next_bucket = (void*)((uptr)map->buckets + ((uptr)next * map->bucket_size));
+
+		memcpy(_bucket, next_bucket, map->bucket_size);
+		map->info[idx] = next_info - 1;
+	}
+}
+
+sint flat_hashmap_pop(flat_hashmap* map, void* bucket, void* out_key)
+{
+	sint hash, idx;
+	void* _bucket;
+
+	flat_hashmap_migrate(map, HASHMAP_MIGRATE);
+
+	hash = map->hash(bucket);
+	_bucket = flat_hashmap_get_index(map, hash, bucket, &idx);
+
+	if (_bucket != NULL)
+	{
+		memcpy(out_key, _bucket, map->bucket_size);
+		flat_hashmap_erase_index(map, idx);
+	}
+	else if ((map->migration != NULL) &&
+		((_bucket = flat_hashmap_get_migrating(map, hash, bucket, &idx)) != NULL))
+	{
+		memcpy(out_key, _bucket, map->bucket_size);
+		flat_hashmap_erase_index(&map->migration->table, idx);
+		map->len--;
+		flat_hashmap_migrate(map, 0);
+		return SUCCESS;
+	}
+	else
+	{
+		return INVALID_INDEX;
+	}
+
+	if ((map->migration == NULL) && CONTAINER_SHOULD_SHRINK(map))
+		flat_hashmap_trim(map);
+
+	return SUCCESS;
+}
+
+void flat_hashmap_get_many(flat_hashmap* map, void* buckets, sint count, void** out_buckets)
+{
+	sint hashes[HASHMAP_BATCH];
+	sint i, j, n, idx, mask;
+
+	if (map->migration != NULL)
+	{
+		for (i = 0; i < count; i++)
+			out_buckets[i] = flat_hashmap_get(map, (void*)((uptr)buckets + ((uptr)i * map->bucket_size)));
+
+		return;
+	}
+
+	mask = map->cap - 1;
+
+	for (i = 0; i < count; i += HASHMAP_BATCH)
+	{
+		n = count - i < HASHMAP_BATCH ? count - i : HASHMAP_BATCH;
+
+		/* Hash the whole batch and start loading the home slots before probing any of them. */
+		for (j = 0; j < n; j++)
+		{
+			void* bucket = (void*)((uptr)buckets + ((uptr)(i + j) * map->bucket_size));
+
+			hashes[j] = map->hash(bucket);
+			idx = hashes[j] & mask;
+			prefetch(map->info + idx);
+			prefetch((void*)((uptr)map->buckets + ((uptr)idx * map->bucket_size)));
+		}
+
+		for (j = 0; j < n; j++)
+		{
+			void* bucket = (void*)((uptr)buckets + ((uptr)(i + j) * map->bucket_size));
+			out_buckets[i + j] = flat_hashmap_get_index(map, hashes[j], bucket, &idx);
+		}
+	}
+}
+
+void flat_hashmap_push_many(flat_hashmap* map, void* buckets, sint count, void** out_buckets)
+{
+	sint hashes[HASHMAP_BATCH];
+	sint i, j, n, idx, mask;
+
+	/* Reserve once up front, so the table and the prefetched slots stay put. */
+	flat_hashmap_reserve(map, map->len + count);
+	flat_hashmap_finish_migration(map);
+	mask = map->cap - 1;
+
+	for (i = 0; i < count; i += HASHMAP_BATCH)
+	{
+		n = count - i < HASHMAP_BATCH ? count - i : HASHMAP_BATCH;
+
+		for (j = 0; j < n; j++)
+		{
+			void* bucket = (void*)((uptr)buckets + ((uptr)(i + j) * map->bucket_size));
+
+			hashes[j] = map->hash(bucket);
+			idx = hashes[j] & mask;
+			prefetch(map->info + idx);
+			prefetch((void*)((uptr)map->buckets + ((uptr)idx * map->bucket_size)));
+		}
+
+		for (j = 0; j < n; j++)
+		{
+			void* bucket = (void*)((uptr)buckets + ((uptr)(i + j) * map->bucket_size));
+			void* _bucket = flat_hashmap_get_index(map, hashes[j], bucket, &idx);
+
+			if (_bucket == NULL)
+				flat_hashmap_insert(map, hashes[j], bucket);
+
+			if (out_buckets != NULL)
+				out_buckets[i + j] = _bucket;
+		}
+	}
+
+	if (out_buckets == NULL)
+		return;
+
+	/* Later inserts of the batch shift buckets around, so existing ones are looked up again. */
+	for (i = 0; i < count; i++)
+	{
+		if (out_buckets[i] != NULL)
+		{
+			void* bucket = (void*)((uptr)buckets + ((uptr)i * map->bucket_size));
+			out_buckets[i] = flat_hashmap_get_index(map, map->hash(bucket), bucket, &idx);
+		}
+	}
+}
+
+
+
+/*************************************************************************************************/
+
+/* Control byte states, full slots store a 7-bit tag (0 - 127). */
+#define CTRL_EMPTY ((s8)-128)
+#define CTRL_DELETED ((s8)-2)
+#define GROUP_WIDTH 16
+
+#if defined(PLATFORM_HAS_NEON)
+static uint neon_movemask(uint8x16_t mask)
+{
+	static const u8 bits[16] = { 1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128 };
+	uint8x16_t masked = vandq_u8(mask, vld1q_u8(bits));
+	return vaddv_u8(vget_low_u8(masked)) | ((uint)vaddv_u8(vget_high_u8(masked)) << 8);
+}
+#endif
+
+/* Bit i is set if ctrl[i] == tag. */
+static uint group_match(const s8* ctrl, s8 tag)
+{
+#if defined(PLATFORM_HAS_SSE2)
+	__m128i group = _mm_loadu_si128((const __m128i*)ctrl);
+	return (uint)_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(tag)));
+
+#elif defined(PLATFORM_HAS_NEON)
+	return neon_movemask(vceqq_s8(vld1q_s8(ctrl), vdupq_n_s8(tag)));
+
+#else
+	uint i, mask;
+
+	for (i = 0, mask = 0; i < GROUP_WIDTH; i++)
+		mask |= (uint)(ctrl[i] == tag) << i;
+
+	return mask;
+
+#endif
+}
+
+/* Bit i is set if ctrl[i] is empty or deleted. */
+static uint group_match_free(const s8* ctrl)
+{
+#if defined(PLATFORM_HAS_SSE2)
+	return (uint)_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)ctrl));
+
+#elif defined(PLATFORM_HAS_NEON)
+	return neon_movemask(vcltzq_s8(vld1q_s8(ctrl)));
+
+#else
+	uint i, mask;
+
+	for (i = 0, mask = 0; i < GROUP_WIDTH; i++)
+		mask |= (uint)(ctrl[i] < 0) << i;
+
+	return mask;
+
+#endif
+}
+
+static s8 group_tag(sint hash)
+{
+	return (s8)(((uint)hash * 0x9E3779B9u) >> 25);
+}
+
+static void flat_group_hashmap_set_ctrl(flat_group_hashmap* map, sint idx, s8 ctrl)
+{
+	/* The first group is mirrored behind the last slot, so groups can be loaded unaligned. */
+	map->ctrl[idx] = ctrl;
+
+	if (idx < GROUP_WIDTH)
+		map->ctrl[map->cap + idx] = ctrl;
+}
+
+static sint flat_group_hashmap_find_free(flat_group_hashmap* map, sint hash)
+{
+	sint mask, pos, step;
+	uint match;
+
+	mask = map->cap - 1;
+	pos = hash & mask;
+
+	for (step = GROUP_WIDTH;; pos = (pos + step) & mask, step += GROUP_WIDTH)
+	{
+		match = group_match_free(map->ctrl + pos);
+
+		if (match != 0)
+			return (pos + ctz(match)) & mask;
+	}
+}
+
+static void flat_group_hashmap_rebuild(flat_group_hashmap* map, sint len)
+{
+	flat_group_hashmap new_map;
+	sint i;
+
+	new_map = flat_group_hashmap_init_alloc(map->bucket_size, len, map->hash, map->cmp, map->alloc);
+	new_map.shrink = map->shrink;
+
+	for (i = 0; i < map->cap; i++)
+	{
+		if (map->ctrl[i] >= 0)
+		{
+			void* _bucket = (void*)((uptr)map->buckets + ((uptr)map->bucket_size * i));
+			sint idx = flat_group_hashmap_find_free(&new_map, map->hash(_bucket));
+
+			memcpy((void*)((uptr)new_map.buckets + ((uptr)idx * new_map.bucket_size)), _bucket,
+				new_map.bucket_size);
+			flat_group_hashmap_set_ctrl(&new_map, idx, map->ctrl[i]);
+		}
+	}
+
+	new_map.len = map->len;
+	flat_group_hashmap_destroy(map);
+	*map = new_map;
+}
+
+flat_group_hashmap flat_group_hashmap_init(sint size, sint len, hashfunc hash, cmpfunc cmp)
+{
+	return flat_group_hashmap_init_alloc(size, len, hash, cmp, NULL);
+}
+
+flat_group_hashmap flat_group_hashmap_init_alloc(sint size, sint len, hashfunc hash, cmpfunc cmp,
+	allocator* alloc)
+{
+	sint sz, cap;
+	flat_group_hashmap map;
+
+	cap = get_container_capacity(len);
+	cap = cap < GROUP_WIDTH ? GROUP_WIDTH : cap;
+	sz = cap * size;
+
+	map.buckets = mem_alloc(alloc, (uptr)sz + cap + GROUP_WIDTH);
+	map.ctrl = (s8*)map.buckets + sz;
+	map.bucket_size = size;
+	map.len = 0;
+	map.cap = cap;
+	map.tombs = 0;
+	map.shrink = CONTAINER_SHRINK_DEFAULT;
+	map.alloc = alloc;
+	map.hash = hash;
+	map.cmp = cmp;
+
+	memset(map.ctrl, CTRL_EMPTY, cap + GROUP_WIDTH);
+	return map;
+}
+
+void flat_group_hashmap_destroy(flat_group_hashmap* map)
+{
+	mem_free(map->alloc, map->buckets, (uptr)map->cap * map->bucket_size + map->cap + GROUP_WIDTH);
+}
+
+void flat_group_hashmap_reserve(flat_group_hashmap* map, sint len)
+{
+	if (len > (map->cap - (map->cap / 4)))
+		flat_group_hashmap_rebuild(map, len * 2);
+}
+
+void flat_group_hashmap_trim(flat_group_hashmap* map)
+{
+	if ((get_container_capacity(map->len * 2) < map->cap) && (map->cap > GROUP_WIDTH))
+		flat_group_hashmap_rebuild(map, map->len * 2);
+}
+
+void* flat_group_hashmap_get_index(flat_group_hashmap* map, sint hash, void* bucket, sint* out_index)
+{
+	sint mask, pos, step;
+	s8 tag;
+
+	mask = map->cap - 1;
+	pos = hash & mask;
+	tag = group_tag(hash);
+
+	for (step = GROUP_WIDTH;; pos = (pos + step) & mask, step += GROUP_WIDTH)
+	{
+		const s8* group = map->ctrl + pos;
+		uint match = group_match(group, tag);
+
+		for (; match != 0; match &= match - 1)
+		{
+			sint idx = (pos + ctz(match)) & mask;
+			void* _bucket = (void*)((uptr)map->buckets + ((uptr)idx * map->bucket_size));
+
+			if (map->cmp(bucket, _bucket) == 0)
+			{
+				*out_index = idx;
+				return _bucket;
+			}
+		}
+
+		/* An empty slot ends every probe sequence that passed through this group. */
+		if (group_match(group, CTRL_EMPTY) != 0)
+		{
+			*out_index = INVALID_INDEX;
+			return NULL;
+		}
+	}
+}
+
+void* flat_group_hashmap_get(flat_group_hashmap* map, void* bucket)
+{
+	sint idx;
+	return flat_group_hashmap_get_index(map, map->hash(bucket), bucket, &idx);
+}
+
+void* flat_group_hashmap_push(flat_group_hashmap* map, void* bucket)
+{
+	sint hash, idx;
+	void* _bucket;
+
+	hash = map->hash(bucket);
+	_bucket = flat_group_hashmap_get_index(map, hash, bucket, &idx);
+
+	if (_bucket != NULL)
+		return _bucket;
+
+	/* Tombstones count against the load factor, rebuild in place if they are the reason. */
+	if ((map->len + map->tombs + 1) > (map->cap - (map->cap / 4)))
+	{
+		if ((map->len + 1) > (map->cap - (map->cap / 4)))
+			flat_group_hashmap_rebuild(map, (map->len + 1) * 2);
+		else
+			flat_group_hashmap_rebuild(map, map->cap);
+	}
+
+	idx = flat_group_hashmap_find_free(map, hash);
+	map->tombs -= map->ctrl[idx] == CTRL_DELETED;
+	flat_group_hashmap_set_ctrl(map, idx, group_tag(hash));
+
+	memcpy((void*)((uptr)map->buckets + ((uptr)idx * map->bucket_size)), bucket, map->bucket_size);
+	map->len++;
+	return NULL;
+}
+
+sint flat_group_hashmap_pop(flat_group_hashmap* map, void* bucket, void* out_bucket)
+{
+	sint idx, mask;
+	uint empty_before, empty_after;
+	void* _bucket;
+
+	_bucket = flat_group_hashmap_get_index(map, map->hash(bucket), bucket, &idx);
+
+	if (_bucket == NULL)
+		return INVALID_INDEX;
+
+	memcpy(out_bucket, _bucket, map->bucket_size);
+
+	/* The slot may only become empty again if no group-wide window around it was ever full,
+	 * otherwise a probe sequence could have passed it and must keep going. */
+	mask = map->cap - 1;
+	empty_before = group_match(map->ctrl + ((idx - GROUP_WIDTH) & mask), CTRL_EMPTY);
+	empty_after = group_match(map->ctrl + idx, CTRL_EMPTY);
+
+	if ((empty_before != 0) & (empty_after != 0) &&
+		(ctz(empty_after) + (clz(empty_before) - 16)) < GROUP_WIDTH)
+	{
+		flat_group_hashmap_set_ctrl(map, idx, CTRL_EMPTY);
+	}
+	else
+	{
+		flat_group_hashmap_set_ctrl(map, idx, CTRL_DELETED);
+		map->tombs++;
+	}
+
+	map->len--;
+	if (CONTAINER_SHOULD_SHRINK(map))
+		flat_group_hashmap_trim(map);
+
+	return SUCCESS;
+}
+
+
+/**************************************************************************************************/
+/*	int_hashmap_t  */
+
+/* Bit i is set if keys[i] == key, for the INT_HASHMAP_GROUP keys starting at 'keys'. */
+static uint int_group_match(const u32* keys, u32 key)
+{
+#if defined(PLATFORM_HAS_SSE2)
+	__m128i group = _mm_loadu_si128((const __m128i*)keys);
+	return (uint)_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(group, _mm_set1_epi32((int)key))));
+
+#elif defined(PLATFORM_HAS_NEON)
+	static const u32 bits[4] = { 1, 2, 4, 8 };
+	return vaddvq_u32(vandq_u32(vceqq_u32(vld1q_u32(keys), vdupq_n_u32(key)), vld1q_u32(bits)));
+
+#else
+	uint i, mask;
+
+	for (i = 0, mask = 0; i < INT_HASHMAP_GROUP; i++)
+		mask |= (uint)(keys[i] == key) << i;
+
+	return mask;
+
+#endif
+}
+
+/* Keys probe from the start of their group, so groups never wrap around the table. */
+static sint int_hashmap_home(u32 key, sint cap)
+{
+	return hash_u32(key) & (cap - 1) & ~(INT_HASHMAP_GROUP - 1);
+}
+
+/* Returns the slot of 'key' or INVALID_INDEX, then 'out_free' receives the first free slot. */
+static sint int_hashmap_find(int_hashmap* map, u32 key, sint* out_free)
+{
+	sint mask, pos;
+	uint match;
+
+	mask = map->cap - 1;
+
+	for (pos = int_hashmap_home(key, map->cap);; pos = (pos + INT_HASHMAP_GROUP) & mask)
+	{
+		match = int_group_match(map->keys + pos, key);
+
+		if (match != 0)
+			return pos + ctz(match);
+
+		match = int_group_match(map->keys + pos, map->empty);
+
+		if (match != 0)
+		{
+			*out_free = pos + ctz(match);
+			return INVALID_INDEX;
+		}
+	}
+}
+
+static void* int_hashmap_value(int_hashmap* map, sint idx)
+{
+	if (map->value_size == 0)
+		return map->keys + idx;
+
+	return (u8*)map->values + (uptr)idx * map->value_size;
+}
+
+static void int_hashmap_rebuild(int_hashmap* map, sint len)
+{
+	int_hashmap new_map;
+	sint i, idx;
+
+	new_map = int_hashmap_init_alloc(map->value_size, len, map->empty, map->alloc);
+	new_map.shrink = map->shrink;
+
+	for (i = 0; i < map->cap; i++)
+	{
+		if (map->keys[i] != map->empty)
+		{
+			int_hashmap_find(&new_map, map->keys[i], &idx);
+			new_map.keys[idx] = map->keys[i];
+
+			if (map->value_size != 0)
+				memcpy(int_hashmap_value(&new_map, idx), int_hashmap_value(map, i), map->value_size);
+		}
+	}
+
+	new_map.len = map->len;
+	int_hashmap_destroy(map);
+	*map = new_map;
+}
+
+int_hashmap int_hashmap_init(sint value_size, sint len, u32 empty)
+{
+	return int_hashmap_init_alloc(value_size, len, empty, NULL);
+}
+
+int_hashmap int_hashmap_init_alloc(sint value_size, sint len, u32 empty, allocator* alloc)
+{
+	sint i, cap;
+	int_hashmap map;
+
+	cap = get_container_capacity(len);
+
+	map.keys = mem_alloc(alloc, (uptr)cap * (sizeof(u32) + value_size));
+	map.values = value_size != 0 ? map.keys + cap : NULL;
+	map.value_size = value_size;
+	map.len = 0;
+	map.cap = cap;
+	map.shrink = CONTAINER_SHRINK_DEFAULT;
+	map.alloc = alloc;
+	map.empty = empty;
+
+	for (i = 0; i < cap; i++)
+		map.keys[i] = empty;
+
+	return map;
+}
+
+void int_hashmap_destroy(int_hashmap* map)
+{
+	mem_free(map->alloc, map->keys, (uptr)map->cap * (sizeof(u32) + map->value_size));
+}
+
+void int_hashmap_reserve(int_hashmap* map, sint len)
+{
+	if (len > (map->cap - (map->cap / 4)))
+		int_hashmap_rebuild(map, len * 2);
+}
+
+void int_hashmap_trim(int_hashmap* map)
+{
+	if (get_container_capacity(map->len * 2) < map->cap)
+		int_hashmap_rebuild(map, map->len * 2);
+}
+
+void* int_hashmap_get(int_hashmap* map, u32 key)
+{
+	sint idx, slot;
+
+	if (key == map->empty)
+		return NULL;
+
+	idx = int_hashmap_find(map, key, &slot);
+	return idx == INVALID_INDEX ? NULL : int_hashmap_value(map, idx);
+}
+
+void* int_hashmap_push(int_hashmap* map, u32 key, const void* value)
+{
+	sint idx, slot;
+
+	assert(key != map->empty);
+
+	idx = int_hashmap_find(map, key, &slot);
+
+	if (idx != INVALID_INDEX)
+		return int_hashmap_value(map, idx);
+
+	if ((map->len + 1) > (map->cap - (map->cap / 4)))
+	{
+		int_hashmap_rebuild(map, (map->len + 1) * 2);
+		int_hashmap_find(map, key, &slot);
+	}
+
+	map->keys[slot] = key;
+
+	if (map->value_size != 0)
+		memcpy(int_hashmap_value(map, slot), value, map->value_size);
+
+	map->len++;
+	return NULL;
+}
+
+sint int_hashmap_pop(int_hashmap* map, u32 key, void* out_value)
+{
+	sint mask, hole, next, slot;
+
+	if (key == map->empty)
+		return INVALID_INDEX;
+
+	hole = int_hashmap_find(map, key, &slot);
+
+	if (hole == INVALID_INDEX)
+		return INVALID_INDEX;
+
+	if ((out_value != NULL) && (map->value_size != 0))
+		memcpy(out_value, int_hashmap_value(map, hole), map->value_size);
+
+	/* Backward shift, keys after the hole move up unless that would put them before their home. */
+	mask = map->cap - 1;
+
+	for (next = (hole + 1) & mask; map->keys[next] != map->empty; next = (next + 1) & mask)
+	{
+		sint home = int_hashmap_home(map->keys[next], map->cap);
+
+		if (((next - home) & mask) >= ((next - hole) & mask))
+		{
+			map->keys[hole] = map->keys[next];
+
+			if (map->value_size != 0)
+				memcpy(int_hashmap_value(map, hole), int_hashmap_value(map, next), map->value_size);
+
+			hole = next;
+		}
+	}
+
+	map->keys[hole] = map->empty;
+	map->len--;
+
+	if (CONTAINER_SHOULD_SHRINK(map))
+		int_hashmap_trim(map);
+
+	return SUCCESS;
+}
+
+
+
+#if defined(PLATFORM_HAS_I64)
+/* The u64 variant of int_hashmap, only key loads and compares differ. */
+static uint int64_group_match(const u64* keys, u64 key)
+{
+#if defined(PLATFORM_HAS_SSE2)
+	__m128i needle = _mm_set1_epi64x((long long)key);
+	__m128i lo = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)keys), needle);
+	__m128i hi = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)(keys + 2)), needle);
+
+	/* Both 32-bit halves have to match. */
+	lo = _mm_and_si128(lo, _mm_shuffle_epi32(lo, _MM_SHUFFLE(2, 3, 0, 1)));
+	hi = _mm_and_si128(hi, _mm_shuffle_epi32(hi, _MM_SHUFFLE(2, 3, 0, 1)));
+	return (uint)_mm_movemask_pd(_mm_castsi128_pd(lo)) | ((uint)_mm_movemask_pd(_mm_castsi128_pd(hi)) << 2);
+
+#elif defined(PLATFORM_HAS_NEON)
+	static const u64 bits[4] = { 1, 2, 4, 8 };
+	uint64x2_t needle = vdupq_n_u64(key);
+	uint64x2_t lo = vandq_u64(vceqq_u64(vld1q_u64(keys), needle), vld1q_u64(bits));
+	uint64x2_t hi = vandq_u64(vceqq_u64(vld1q_u64(keys + 2), needle), vld1q_u64(bits + 2));
+	return (uint)vaddvq_u64(vorrq_u64(lo, hi));
+
+#else
+	uint i, mask;
+
+	for (i = 0, mask = 0; i < INT_HASHMAP_GROUP; i++)
+		mask |= (uint)(keys[i] == key) << i;
+
+	return mask;
+
+#endif
+}
+
+static sint int64_hashmap_home(u64 key, sint cap)
+{
+	return hash_u64(key) & (cap - 1) & ~(INT_HASHMAP_GROUP - 1);
+}
+
+static sint int64_hashmap_find(int64_hashmap* map, u64 key, sint* out_free)
+{
+	sint mask, pos;
+	uint match;
+
+	mask = map->cap - 1;
+
+	for (pos = int64_hashmap_home(key, map->cap);; pos = (pos + INT_HASHMAP_GROUP) & mask)
+	{
+		match = int64_group_match(map->keys + pos, key);
+
+		if (match != 0)
+			return pos + ctz(match);
+
+		match = int64_group_match(map->keys + pos, map->empty);
+
+		if (match != 0)
+		{
+			*out_free = pos + ctz(match);
+			return INVALID_INDEX;
+		}
+	}
+}
+
+static void* int64_hashmap_value(int64_hashmap* map, sint idx)
+{
+	if (map->value_size == 0)
+		return map->keys + idx;
+
+	return (u8*)map->values + (uptr)idx * map->value_size;
+}
+
+static void int64_hashmap_rebuild(int64_hashmap* map, sint len)
+{
+	int64_hashmap new_map;
+	sint i, idx;
+
+	new_map = int64_hashmap_init_alloc(map->value_size, len, map->empty, map->alloc);
+	new_map.shrink = map->shrink;
+
+	for (i = 0; i < map->cap; i++)
+	{
+		if (map->keys[i] != map->empty)
+		{
+			int64_hashmap_find(&new_map, map->keys[i], &idx);
+			new_map.keys[idx] = map->keys[i];
+
+			if (map->value_size != 0)
+				memcpy(int64_hashmap_value(&new_map, idx), int64_hashmap_value(map, i), map->value_size);
+		}
+	}
+
+	new_map.len = map->len;
+	int64_hashmap_destroy(map);
+	*map = new_map;
+}
+
+int64_hashmap int64_hashmap_init(sint value_size, sint len, u64 empty)
+{
+	return int64_hashmap_init_alloc(value_size, len, empty, NULL);
+}
+
+int64_hashmap int64_hashmap_init_alloc(sint value_size, sint len, u64 empty, allocator* alloc)
+{
+	sint i, cap;
+	int64_hashmap map;
+
+	cap = get_container_capacity(len);
+
+	map.keys = mem_alloc(alloc, (uptr)cap * (sizeof(u64) + value_size));
+	map.values = value_size != 0 ? map.keys + cap : NULL;
+	map.value_size = value_size;
+	map.len = 0;
+	map.cap = cap;
+	map.shrink = CONTAINER_SHRINK_DEFAULT;
+	map.alloc = alloc;
+	map.empty = empty;
+
+	for (i = 0; i < cap; i++)
+		map.keys[i] = empty;
+
+	return map;
+}
+
+void int64_hashmap_destroy(int64_hashmap* map)
+{
+	mem_free(map->alloc, map->keys, (uptr)map->cap * (sizeof(u64) + map->value_size));
+}
+
+void int64_hashmap_reserve(int64_hashmap* map, sint len)
+{
+	if (len > (map->cap - (map->cap / 4)))
+		int64_hashmap_rebuild(map, len * 2);
+}
+
+void int64_hashmap_trim(int64_hashmap* map)
+{
+	if (get_container_capacity(map->len * 2) < map->cap)
+		int64_hashmap_rebuild(map, map->len * 2);
+}
+
+void* int64_hashmap_get(int64_hashmap* map, u64 key)
+{
+	sint idx, slot;
+
+	if (key == map->empty)
+		return NULL;
+
+	idx = int64_hashmap_find(map, key, &slot);
+	return idx == INVALID_INDEX ? NULL : int64_hashmap_value(map, idx);
+}
+
+void* int64_hashmap_push(int64_hashmap* map, u64 key, const void* value)
+{
+	sint idx, slot;
+
+	assert(key != map->empty);
+
+	idx = int64_hashmap_find(map, key, &slot);
+
+	if (idx != INVALID_INDEX)
+		return int64_hashmap_value(map, idx);
+
+	if ((map->len + 1) > (map->cap - (map->cap / 4)))
+	{
+		int64_hashmap_rebuild(map, (map->len + 1) * 2);
+		int64_hashmap_find(map, key, &slot);
+	}
+
+	map->keys[slot] = key;
+
+	if (map->value_size != 0)
+		memcpy(int64_hashmap_value(map, slot), value, map->value_size);
+
+	map->len++;
+	return NULL;
+}
+
+sint int64_hashmap_pop(int64_hashmap* map, u64 key, void* out_value)
+{
+	sint mask, hole, next, slot;
+
+	if (key == map->empty)
+		return INVALID_INDEX;
+
+	hole = int64_hashmap_find(map, key, &slot);
+
+	if (hole == INVALID_INDEX)
+		return INVALID_INDEX;
+
+	if ((out_value != NULL) && (map->value_size != 0))
+		memcpy(out_value, int64_hashmap_value(map, hole), map->value_size);
+
+	mask = map->cap - 1;
+
+	for (next = (hole + 1) & mask; map->keys[next] != map->empty; next = (next + 1) & mask)
+	{
+		sint home = int64_hashmap_home(map->keys[next], map->cap);
+
+		if (((next - home) & mask) >= ((next - hole) & mask))
+		{
+			map->keys[hole] = map->keys[next];
+
+			if (map->value_size != 0)
+				memcpy(int64_hashmap_value(map, hole), int64_hashmap_value(map, next), map->value_size);
+
+			hole = next;
+		}
+	}
+
+	map->keys[hole] = map->empty;
+	map->len--;
+
+	if (CONTAINER_SHOULD_SHRINK(map))
+		int64_hashmap_trim(map);
+
+	return SUCCESS;
+}
+
+#endif /* I64 */
+
+
+
+/**************************************************************************************************/
+/*	flat_ordered_hashmap_t  */
+
+#define ORDERED_DEAD(map, i) (((map)->dead[(i) >> 5] >> ((i) & 31)) & 1)
+
+/* Dense, sparse, dead and info share one allocation, returns the offset of the sparse array. */
+static uptr flat_ordered_hashmap_sparse_offset(sint size, sint cap)
+{
+	uptr sz, rest;
+
+	sz = (uptr)cap * size;
+	rest = sz % sizeof(sint);
+
+	if (rest != 0)
+		sz += sizeof(sint) - rest;
+
+	return sz;
+}
+
+static uptr flat_ordered_hashmap_alloc_size(sint size, sint cap)
+{
+	return flat_ordered_hashmap_sparse_offset(size, cap) + (sizeof(sint) * cap) +
+		(sizeof(u32) * ((cap + 31) / 32)) + cap;
+}
+
+flat_ordered_hashmap flat_ordered_hashmap_init(sint size, sint len, sint(*hash)(void* a), sint(*cmp)(void* a, void* b))
+{
+	return flat_ordered_hashmap_init_alloc(size, len, hash, cmp, NULL);
+}
+
+flat_ordered_hashmap flat_ordered_hashmap_init_alloc(sint size, sint len, sint(*hash)(void* a),
+	sint(*cmp)(void* a, void* b), allocator* alloc)
+{
+	sint cap, words;
+	flat_ordered_hashmap map;
+
+	cap = get_container_capacity(len);
+	words = (cap + 31) / 32;
+
+	map.dense = mem_alloc(alloc, flat_ordered_hashmap_alloc_size(size, cap));
+	map.sparse = (sint*)((uptr)map.dense + flat_ordered_hashmap_sparse_offset(size, cap));
+	map.dead = (u32*)(map.sparse + cap);
+	map.info = (u8*)(map.dead + words);
+	map.bucket_size = size;
+	map.cap = cap;
+	map.len = 0;
+	map.tombs = 0;
+	map.shrink = CONTAINER_SHRINK_DEFAULT;
+	map.incremental = 0;
+	map.alloc = alloc;
+	map.hash = hash;
+	map.cmp = cmp;
+	map.migration = NULL;
+
+	memset(map.dead, 0, sizeof(u32) * words);
+	memset(map.info, -1, map.cap);
+	return map;
+}
+
+void flat_ordered_hashmap_destroy(flat_ordered_hashmap* map)
+{
+	flat_ordered_hashmap_migration* migration = map->migration;
+
+	if (migration != NULL)
+	{
+		mem_free(map->alloc, migration->memory, flat_ordered_hashmap_alloc_size(map->bucket_size, migration->cap));
+		mem_free(map->alloc, migration, sizeof(flat_ordered_hashmap_migration));
+	}
+
+	mem_free(map->alloc, map->dense, flat_ordered_hashmap_alloc_size(map->bucket_size, map->cap));
+}
+
+/* Robin hood insert of the dense index 'value', starting at slot 'idx' 'distance' slots away from
+ * its home slot. */
+static void flat_ordered_hashmap_insert_index(flat_ordered_hashmap* map, sint idx, sint distance, sint value)
+{
+	sint mask = map->cap - 1;
+
+	for (;; idx = (idx + 1) & mask, distance++)
+	{
+		sint _distance = map->info[idx];
+
+		if (_distance == 0xFF)
+		{
+			map->sparse[idx] = value;
+			map->info[idx] = distance;
+			return;
+		}
+		else if (distance > _distance)
+		{
+			sint tmp = map->sparse[idx];
+
+			map->sparse[idx] = value;
+			map->info[idx] = distance;
+			value = tmp;
+			distance = _distance;
+		}
+	}
+}
+
+/* Removes slot 'idx' from the index with a robin hood backward shift. */
+static void flat_ordered_hashmap_erase_index(flat_ordered_hashmap* map, sint idx)
+{
+	sint mask, next;
+
+	mask = map->cap - 1;
+
+	for (next = (idx + 1) & mask;; idx = next, next = (next + 1) & mask)
+	{
+		sint next_distance = map->info[next];
+
+		if ((next_distance == 0xFF) | (next_distance == 0))
+		{
+			map->info[idx] = 0xFF;
+			return;
+		}
+
+		map->sparse[idx] = map->sparse[next];
+		map->info[idx] = next_distance - 1;
+	}
+}
+
+/* A view of the map using the old index of a running migration. */
+static flat_ordered_hashmap flat_ordered_hashmap_old_index(flat_ordered_hashmap* map)
+{
+	flat_ordered_hashmap old;
+
+	old = *map;
+	old.sparse = map->migration->sparse;
+	old.info = map->migration->info;
+	old.cap = map->migration->cap;
+	return old;
+}
+
+/* The dense array is copied at once together with its tombstones. Only the index is rebuilt
+ * incrementally, the old one answers lookups of the entries not indexed yet. */
+static void flat_ordered_hashmap_begin_migration(flat_ordered_hashmap* map, sint len)
+{
+	flat_ordered_hashmap_migration* migration;
+	flat_ordered_hashmap new_map;
+	sint end;
+
+	end = map->len + map->tombs;
+	migration = mem_alloc(map->alloc, sizeof(flat_ordered_hashmap_migration));
+	migration->memory = map->dense;
+	migration->sparse = map->sparse;
+	migration->info = map->info;
+	migration->cap = map->cap;
+	migration->len = end;
+	migration->done = 0;
+
+	new_map = flat_ordered_hashmap_init_alloc(map->bucket_size, len, map->hash, map->cmp, map->alloc);
+	memcpy(new_map.dense, map->dense, (uptr)end * map->bucket_size);
+	memcpy(new_map.dead, map->dead, sizeof(u32) * ((end + 31) / 32));
+	new_map.len = map->len;
+	new_map.tombs = map->tombs;
+	new_map.shrink = map->shrink;
+	new_map.incremental = map->incremental;
+	new_map.migration = migration;
+	*map = new_map;
+}
+
+void flat_ordered_hashmap_migrate(flat_ordered_hashmap* map, sint count)
+{
+	flat_ordered_hashmap_migration* migration;
+	sint mask;
+
+	migration = map->migration;
+
+	if (migration == NULL)
+		return;
+
+	mask = map->cap - 1;
+
+	for (; (count > 0) & (migration->done < migration->len); count--, migration->done++)
+	{
+		void* _bucket;
+
+		if (ORDERED_DEAD(map, migration->done))
+			continue;
+
+		_bucket = (void*)((uptr)map->dense + ((uptr)migration->done * map->bucket_size));
+		flat_ordered_hashmap_insert_index(map, map->hash(_bucket) & mask, 0, migration->done);
+	}
+
+	if (migration->done == migration->len)
+	{
+		mem_free(map->alloc, migration->memory, flat_ordered_hashmap_alloc_size(map->bucket_size, migration->cap));
+		mem_free(map->alloc, migration, sizeof(flat_ordered_hashmap_migration));
+		map->migration = NULL;
+	}
+}
+
+static void flat_ordered_hashmap_finish_migration(flat_ordered_hashmap* map)
+{
+	if (map->migration != NULL)
+		flat_ordered_hashmap_migrate(map, map->migration->len);
+}
+
+void* flat_ordered_hashmap_get_index(flat_ordered_hashmap* map, sint hash, sint* bucket, sint* out_index)
+{
+	int mask, idx, distance;
+
+	mask = map->cap - 1;
+	idx = hash & mask;
+	distance = 0;
+
+	for (;; idx = (idx + 1) & mask, distance++)
+	{
+		void* _bucket;
+		sint _distance;
+
+		_distance = map->info[idx];
+
+		if ((_distance == 0xFF) | (distance > _distance))
+		{
+			*out_index = idx;
+			return NULL;
+		}
+
+		_bucket = (void*)((uptr)map->dense + ((uptr)map->sparse[idx] * map->bucket_size));
+
+		if (map->cmp(bucket, _bucket) == 0)
+		{
+			*out_index = idx;
+			return _bucket;
+		}
+	}
+}
+
+/* Look up a bucket through the old index, entries already indexed in the new one are skipped. */
+static void* flat_ordered_hashmap_get_migrating(flat_ordered_hashmap* map, sint hash, void* bucket)
+{
+	flat_ordered_hashmap old;
+	sint idx;
+	void* _bucket;
+
+	old = flat_ordered_hashmap_old_index(map);
+	_bucket = flat_ordered_hashmap_get_index(&old, hash, bucket, &idx);
+
+	if ((_bucket != NULL) && (old.sparse[idx] < map->migration->done))
+		return NULL;
+
+	return _bucket;
+}
+
+void* flat_ordered_hashmap_get(flat_ordered_hashmap* map, void* bucket)
+{
+	sint hash, idx;
+	void* _bucket;
+
+	hash = map->hash(bucket);
+	_bucket = flat_ordered_hashmap_get_index(map, hash, bucket, &idx);
+
+	if ((_bucket == NULL) && (map->migration != NULL))
+		_bucket = flat_ordered_hashmap_get_migrating(map, hash, bucket);
+
+	return _bucket;
+}
+
+/* Push without reserving, the caller makes sure there is room. */
+static void* flat_ordered_hashmap_push_hashed(flat_ordered_hashmap* map, sint hash, void* bucket)
+{
+	sint mask, idx, distance, end;
+	void* _bucket;
+
+	_bucket = flat_ordered_hashmap_get_index(map, hash, bucket, &idx);
+
+	if (_bucket != NULL)
+		return _bucket;
+
+	/* Append bucket to dense, behind the tombstones */
+	end = map->len + map->tombs;
+	_bucket = (void*)((uptr)map->dense + ((uptr)end * map->bucket_size));
+	memcpy(_bucket, bucket, map->bucket_size);
+
+	mask = map->cap - 1;
+	distance = ((map->cap + idx) - (hash & mask)) & mask;
+	flat_ordered_hashmap_insert_index(map, idx, distance, end);
+	map->len++;
+	return NULL;
+}
+
+/* Rebuilds the map with room for 'len' entries, tombstones are dropped on the way. */
+static void flat_ordered_hashmap_rebuild(flat_ordered_hashmap* map, sint len)
+{
+	flat_ordered_hashmap new_map;
+	sint i, end;
+
+	new_map = flat_ordered_hashmap_init_alloc(map->bucket_size, len, map->hash, map->cmp, map->alloc);
+	new_map.shrink = map->shrink;
+	new_map.incremental = map->incremental;
+	end = map->len + map->tombs;
+
+	for (i = 0; i < end; i++)
+	{
+		void* _bucket;
+
+		if (ORDERED_DEAD(map, i))
+			continue;
+
+		_bucket = (void*)((uptr)map->dense + ((uptr)map->bucket_size * i));
+		flat_ordered_hashmap_push_hashed(&new_map, map->hash(_bucket), _bucket);
+	}
+
+	flat_ordered_hashmap_destroy(map);
+	*map = new_map;
+}
+
+void flat_ordered_hashmap_reserve(flat_ordered_hashmap* map, sint len)
+{
+	/* Tombstones take dense slots until the next compaction. */
+	if ((len + map->tombs) > (map->cap - (map->cap / 4)))
+	{
+		flat_ordered_hashmap_finish_migration(map);
+
+		if (map->incremental && (map->len > 0))
+		{
+			flat_ordered_hashmap_begin_migration(map, (len + map->tombs) * 2);
+			return;
+		}
+
+		flat_ordered_hashmap_rebuild(map, len * 2);
+	}
+}
+
+void flat_ordered_hashmap_trim(flat_ordered_hashmap* map)
+{
+	flat_ordered_hashmap_finish_migration(map);
+
+	if (get_container_capacity(map->len * 2) < map->cap)
+		flat_ordered_hashmap_rebuild(map, map->len * 2);
+	else
+		flat_ordered_hashmap_compact(map);
+}
+
+void flat_ordered_hashmap_compact(flat_ordered_hashmap* map)
+{
+	sint* removed;
+	sint i, w, end, words, total;
+
+	if (map->tombs == 0)
+		return;
+
+	flat_ordered_hashmap_finish_migration(map);
+
+	end = map->len + map->tombs;
+	words = (end + 31) / 32;
+
+	/* Tombstones in front of every bitmap word, so a dense index drops by the ones before it. */
+	removed = mem_alloc(map->alloc, sizeof(sint) * words);
+
+	for (i = 0, total = 0; i < words; i++)
+	{
+		removed[i] = total;
+		total += popcount(map->dead[i]);
+	}
+
+	for (i = 0, w = 0; i < end; i++)
+	{
+		if (ORDERED_DEAD(map, i))
+			continue;
+
+		if (w != i)
+		{
+			memcpy((void*)((uptr)map->dense + ((uptr)w * map->bucket_size)),
+				(void*)((uptr)map->dense + ((uptr)i * map->bucket_size)), map->bucket_size);
+		}
+
+		w++;
+	}
+
+	for (i = 0; i < map->cap; i++)
+	{
+		sint s;
+
+		if (map->info[i] == 0xFF)
+			continue;
+
+		s = map->sparse[i];
+		map->sparse[i] = s - removed[s >> 5] - popcount(map->dead[s >> 5] & ((1u << (s & 31)) - 1));
+	}
+
+	memset(map->dead, 0, sizeof(u32) * words);
+	map->tombs = 0;
+	mem_free(map->alloc, removed, sizeof(sint) * words);
+}
+
+void* flat_ordered_hashmap_push(flat_ordered_hashmap* map, void* bucket)
+{
+	sint hash;
+	void* _bucket;
+
+	flat_ordered_hashmap_reserve(map, map->len + 1);
+	flat_ordered_hashmap_migrate(map, HASHMAP_MIGRATE);
+	hash = map->hash(bucket);
+
+	if ((map->migration != NULL) && ((_bucket = flat_ordered_hashmap_get_migrating(map, hash, bucket)) != NULL))
+		return _bucket;
+
+	return flat_ordered_hashmap_push_hashed(map, hash, bucket);
+}
+
+sint flat_ordered_hashmap_pop(flat_ordered_hashmap* map, void* bucket, void* out_bucket)
+{
+	flat_ordered_hashmap index;
+	sint hash, idx, dense_idx;
+	void* _bucket;
+
+	hash = map->hash(bucket);
+	index = *map;
+	_bucket = flat_ordered_hashmap_get_index(&index, hash, bucket, &idx);
+
+	if ((_bucket == NULL) && (map->migration != NULL))
+	{
+		index = flat_ordered_hashmap_old_index(map);
+		_bucket = flat_ordered_hashmap_get_index(&index, hash, bucket, &idx);
+
+		if ((_bucket != NULL) && (index.sparse[idx] < map->migration->done))
+			_bucket = NULL;
+	}
+
+	if (_bucket == NULL)
+		return INVALID_INDEX;
+
+	dense_idx = index.sparse[idx];
+	memcpy(out_bucket, _bucket, map->bucket_size);
+	flat_ordered_hashmap_erase_index(&index, idx);
+	map->len--;
+
+	/* The last entry is simply dropped, a running migration may still have to skip it though. */
+	if ((dense_idx != map->len + map->tombs) || (map->migration != NULL))
+	{
+		map->dead[dense_idx >> 5] |= 1u << (dense_idx & 31);
+		map->tombs++;
+	}
+
+	if (map->migration == NULL)
+	{
+		if (CONTAINER_SHOULD_SHRINK(map))
+			flat_ordered_hashmap_trim(map);
+		else if (map->tombs > map->len)
+			flat_ordered_hashmap_compact(map);
+	}
+
+	return SUCCESS;
+}
+
+void flat_ordered_hashmap_get_many(flat_ordered_hashmap* map, void* buckets, sint count, void** out_buckets)
+{
+	sint hashes[HASHMAP_BATCH];
+	sint i, j, n, idx, mask;
+
+	if (map->migration != NULL)
+	{
+		for (i = 0; i < count; i++)
+			out_buckets[i] = flat_ordered_hashmap_get(map, (void*)((uptr)buckets + ((uptr)i * map->bucket_size)));
+
+		return;
+	}
+
+	mask = map->cap - 1;
+
+	for (i = 0; i < count; i += HASHMAP_BATCH)
+	{
+		n = count - i < HASHMAP_BATCH ? count - i : HASHMAP_BATCH;
+
+		for (j = 0; j < n; j++)
+		{
+			void* bucket = (void*)((uptr)buckets + ((uptr)(i + j) * map->bucket_size));
+
+			hashes[j] = map->hash(bucket);
+			idx = hashes[j] & mask;
+			prefetch(map->info + idx);
+			prefetch(map->sparse + idx);
+		}
+
+		for (j = 0; j < n; j++)
+		{
+			void* bucket = (void*)((uptr)buckets + ((uptr)(i + j) * map->bucket_size));
+			out_buckets[i + j] = flat_ordered_hashmap_get_index(map, hashes[j], bucket, &idx);
+		}
+	}
+}
+
+sint flat_ordered_hashmap_begin(flat_ordered_hashmap* map)
+{
+	return flat_ordered_hashmap_next(map, INVALID_INDEX);
+}
+
+sint flat_ordered_hashmap_next(flat_ordered_hashmap* map, sint pos)
+{
+	sint end = map->len + map->tombs;
+
+	for (pos++; pos < end; pos = (pos | 31) + 1)
+	{
+		/* Live entries have a clear bit, bits past the end are clear as well. */
+		u32 live = ~map->dead[pos >> 5] >> (pos & 31);
+
+		if (live != 0)
+		{
+			pos += ctz(live);
+			return pos < end ? pos : INVALID_INDEX;
+		}
+	}
+
+	return INVALID_INDEX;
+}
+
+void* flat_ordered_hashmap_at(flat_ordered_hashmap* map, sint pos)
+{
+	return (void*)((uptr)map->dense + ((uptr)pos * map->bucket_size));
+}
+
+void flat_ordered_hashmap_push_many(flat_ordered_hashmap* map, void* buckets, sint count, void** out_buckets)
+{
+	sint hashes[HASHMAP_BATCH];
+	sint i, j, n, idx, mask;
+
+	flat_ordered_hashmap_reserve(map, map->len + count);
+	flat_ordered_hashmap_finish_migration(map);
+	mask = map->cap - 1;
+
+	for (i = 0; i < count; i += HASHMAP_BATCH)
+	{
+		n = count - i < HASHMAP_BATCH ? count - i : HASHMAP_BATCH;
+
+		for (j = 0; j < n; j++)
+		{
+			void* bucket = (void*)((uptr)buckets + ((uptr)(i + j) * map->bucket_size));
+
+			hashes[j] = map->hash(bucket);
+			idx = hashes[j] & mask;
+			prefetch(map->info + idx);
+			prefetch(map->sparse + idx);
+		}
+
+		for (j = 0; j < n; j++)
+		{
+			void* bucket = (void*)((uptr)buckets + ((uptr)(i + j) * map->bucket_size));
+			void* _bucket = flat_ordered_hashmap_push_hashed(map, hashes[j], bucket);
+
+			if (out_buckets != NULL)
+				out_buckets[i + j] = _bucket;
+		}
+	}
+}
+
+
+
+/**************************************************************************************************/
+/*	cache_t  */
+
+typedef struct cache_meta
+{
+	uptr cost;
+	u32 ref;
+} cache_meta;
+
+static cache_meta* cache_meta_of(cache* cache, void* entry)
+{
+	return (cache_meta*)((uptr)entry + cache->meta_offset);
+}
+
+/* Drops the tombstones, 'hand' keeps its place in the dense order. The map would otherwise
+ * compact or rebuild on its own and move the buckets under the hand. */
+static void cache_compact(cache* cache)
+{
+	flat_ordered_hashmap* map = &cache->map;
+	sint i, hand, dead;
+
+	hand = cache->hand;
+
+	for (i = 0, dead = 0; i < (hand >> 5); i++)
+		dead += popcount(map->dead[i]);
+
+	if ((hand & 31) != 0)
+		dead += popcount(map->dead[hand >> 5] & ((1u << (hand & 31)) - 1));
+
+	cache->hand = hand - dead;
+	flat_ordered_hashmap_compact(map);
+}
+
+/* 'bucket' must not point into the map, the entry is popped into 'scratch'. */
+static sint cache_erase(cache* cache, void* bucket)
+{
+	flat_ordered_hashmap* map = &cache->map;
+	sint result;
+
+	if ((map->tombs + 1) > (map->len - 1))
+		cache_compact(cache);
+
+	result = flat_ordered_hashmap_pop(map, bucket, cache->scratch);
+
+	/* The last entry is dropped instead of left behind, the next one appended takes its place. */
+	if (cache->hand > map->len + map->tombs)
+		cache->hand = map->len + map->tombs;
+
+	return result;
+}
+
+/* Appends the entry in 'scratch', returns where it ended up. */
+static void* cache_insert(cache* cache)
+{
+	flat_ordered_hashmap* map = &cache->map;
+
+	if ((map->len + 1 + map->tombs) > (map->cap - (map->cap / 4)))
+		cache_compact(cache);
+
+	flat_ordered_hashmap_push(map, cache->scratch);
+	return flat_ordered_hashmap_at(map, map->len + map->tombs - 1);
+}
+
+static void* cache_use(cache* cache, void* entry)
+{
+	flat_ordered_hashmap* map = &cache->map;
+
+	if (cache->policy == CACHE_CLOCK)
+	{
+		cache_meta_of(cache, entry)->ref = 1;
+		return entry;
+	}
+
+	if (entry == flat_ordered_hashmap_at(map, map->len + map->tombs - 1))
+		return entry;
+
+	memcpy(cache->scratch, entry, map->bucket_size);
+	cache_erase(cache, cache->scratch);
+	return cache_insert(cache);
+}
+
+static void cache_evict(cache* cache)
+{
+	flat_ordered_hashmap* map = &cache->map;
+	cache_meta* meta;
+	void* entry;
+	sint pos;
+
+	for (;;)
+	{
+		pos = flat_ordered_hashmap_next(map, cache->hand - 1);
+
+		if (pos == INVALID_INDEX)
+		{
+			cache->hand = 0;
+			continue;
+		}
+
+		entry = flat_ordered_hashmap_at(map, pos);
+		meta = cache_meta_of(cache, entry);
+		cache->hand = pos + 1;
+
+		/* LRU entries are never referenced, the hand stays at the front. */
+		if (meta->ref == 0)
+			break;
+
+		meta->ref = 0;
+	}
+
+	if (cache->evict != NULL)
+		cache->evict(entry, cache->user);
+
+	cache->cost -= meta->cost;
+	cache->evictions++;
+
+	memcpy(cache->scratch, entry, map->bucket_size);
+	cache_erase(cache, cache->scratch);
+}
+
+cache cache_init(sint size, sint max_len, uptr max_cost, sint policy, hashfunc hash, cmpfunc cmp)
+{
+	return cache_init_alloc(size, max_len, max_cost, policy, hash, cmp, NULL);
+}
+
+cache cache_init_alloc(sint size, sint max_len, uptr max_cost, sint policy, hashfunc hash, cmpfunc cmp,
+	allocator* alloc)
+{
+	cache cache;
+	sint offset;
+
+	offset = (size + (sint)sizeof(uptr) - 1) & ~((sint)sizeof(uptr) - 1);
+
+	/* Room for as many tombstones as entries, trimming would move the hand. */
+	cache.map = flat_ordered_hashmap_init_alloc(offset + sizeof(cache_meta), max_len * 2, hash, cmp, alloc);
+	cache.map.shrink = CONTAINER_SHRINK_MANUAL;
+	cache.scratch = mem_alloc(alloc, cache.map.bucket_size);
+	cache.bucket_size = size;
+	cache.meta_offset = offset;
+	cache.policy = policy;
+	cache.max_len = max_len;
+	cache.max_cost = max_cost;
+	cache.cost = 0;
+	cache.hand = 0;
+	cache.evict = NULL;
+	cache.user = NULL;
+	cache.hits = 0;
+	cache.misses = 0;
+	cache.evictions = 0;
+	return cache;
+}
+
+void cache_destroy(cache* cache)
+{
+	flat_ordered_hashmap* map = &cache->map;
+	sint pos;
+
+	if (cache->evict != NULL)
+	{
+		for (pos = flat_ordered_hashmap_begin(map); pos != INVALID_INDEX; pos = flat_ordered_hashmap_next(map, pos))
+			cache->evict(flat_ordered_hashmap_at(map, pos), cache->user);
+	}
+
+	mem_free(map->alloc, cache->scratch, map->bucket_size);
+	flat_ordered_hashmap_destroy(map);
+}
+
+void* cache_get(cache* cache, void* bucket)
+{
+	void* entry;
+
+	entry = flat_ordered_hashmap_get(&cache->map, bucket);
+
+	if (entry == NULL)
+	{
+		cache->misses++;
+		return NULL;
+	}
+
+	cache->hits++;
+	return cache_use(cache, entry);
+}
+
+void* cache_put(cache* cache, void* bucket, uptr cost)
+{
+	flat_ordered_hashmap* map = &cache->map;
+	cache_meta* meta;
+	void* entry;
+
+	entry = flat_ordered_hashmap_get(map, bucket);
+
+	if (entry != NULL)
+		return cache_use(cache, entry);
+
+	/* Compared without the sum, it could wrap. */
+	while ((map->len > 0) && (((cache->max_len != 0) && (map->len >= cache->max_len)) ||
+		((cache->max_cost != 0) &&
+		((cache->cost > cache->max_cost) || (cost > cache->max_cost - cache->cost)))))
+	{
+		cache_evict(cache);
+	}
+
+	memcpy(cache->scratch, bucket, cache->bucket_size);
+	meta = cache_meta_of(cache, cache->scratch);
+	meta->cost = cost;
+	meta->ref = 0;
+
+	cache->cost += cost;
+	cache_insert(cache);
+	return NULL;
+}
+
+sint cache_touch(cache* cache, void* bucket)
+{
+	void* entry;
+
+	entry = flat_ordered_hashmap_get(&cache->map, bucket);
+
+	if (entry == NULL)
+		return INVALID_INDEX;
+
+	cache_use(cache, entry);
+	return SUCCESS;
+}
+
+sint cache_pop(cache* cache, void* bucket, void* out_bucket)
+{
+	/* Erasing may compact, 'bucket' might be a result of cache_get. */
+	memcpy(cache->scratch, bucket, cache->bucket_size);
+
+	if (cache_erase(cache, cache->scratch) != SUCCESS)
+		return INVALID_INDEX;
+
+	cache->cost -= cache_meta_of(cache, cache->scratch)->cost;
+	memcpy(out_bucket, cache->scratch, cache->bucket_size);
+	return SUCCESS;
+}
+
+
+
+/**************************************************************************************************/
+/*	pool_t  */
+
+
+
+pool pool_init(sint size, sint len, sint bcap)
+{
+	return pool_init_alloc(size, len, bcap, NULL);
+}
+
+pool pool_init_alloc(sint size, sint len, sint bcap, allocator* alloc)
+{
+	pool pool;
+
+	bcap = get_container_capacity(bcap);
+
+	pool.data = NULL;
+	pool.elem_size = size;
+	pool.len = 0;
+	pool.cap = 0;
+	pool.bcap = bcap;
+	pool.bshift = ctz(bcap);
+	pool.free = INVALID_INDEX;
+	pool.alloc = alloc;
+
+	pool_reserve(&pool, len);
+	return pool;
+}
+
+void pool_destroy(pool* pool)
+{
+	sint i, blocks;
+
+	blocks = pool->cap >> pool->bshift;
+
+	for (i = 0; i < blocks; i++)
+		mem_free(pool->alloc, pool->data[i], (uptr)pool->bcap * pool->elem_size);
+
+	if (blocks != 0)
+		mem_free(pool->alloc, pool->data, sizeof(void*) * get_container_capacity(blocks));
+}
+
+void pool_reserve(pool* pool, sint len)
+{
+	while (pool->cap < len)
+	{
+		sint i, blocks;
+		u8* block;
+
+		blocks = pool->cap >> pool->bshift;
+
+		/* Only the block table moves, the blocks themselves stay in place. */
+		if ((blocks == 0) | (blocks == get_container_capacity(blocks)))
+			pool->data = mem_realloc(pool->alloc, pool->data, sizeof(void*) * blocks,
+				sizeof(void*) * get_container_capacity(blocks + 1));
+
+		block = mem_alloc(pool->alloc, (uptr)pool->bcap * pool->elem_size);
+		pool->data[blocks] = block;
+
+		/* Link the new elems in reverse, so the lowest index is handed out first. */
+		for (i = pool->bcap - 1; i >= 0; i--)
+		{
+			*(sint*)(block + (uptr)i * pool->elem_size) = pool->free;
+			pool->free = pool->cap + i;
+		}
+
+		pool->cap += pool->bcap;
+	}
+}
+
+void* pool_get(pool* pool, sint idx)
+{
+	u8* block = pool->data[idx >> pool->bshift];
+	return block + (uptr)(idx & (pool->bcap - 1)) * pool->elem_size;
+}
+
+u32 pool_push(pool* pool, void* elem)
+{
+	sint idx;
+	void* _elem;
+
+	if (pool->free == INVALID_INDEX)
+		pool_reserve(pool, pool->cap + 1);
+
+	idx = pool->free;
+	_elem = pool_get(pool, idx);
+	pool->free = *(sint*)_elem;
+	pool->len++;
+
+	memcpy(_elem, elem, pool->elem_size);
+	return idx;
+}
+
+void pool_erase(pool* pool, sint idx)
+{
+	if ((uint)idx >= (uint)pool->cap)
+		return;
+
+	*(sint*)pool_get(pool, idx) = pool->free;
+	pool->free = idx;
+	pool->len--;
+}
+
+
+
+/**************************************************************************************************/
+/*	slot_map_t  */
+
+
+
+slot_map slot_map_init(sint size, sint len)
+{
+	return slot_map_init_alloc(size, len, NULL);
+}
+
+slot_map slot_map_init_alloc(sint size, sint len, allocator* alloc)
+{
+	return slot_map_init_columns(&size, 1, len, alloc);
+}
+
+slot_map slot_map_init_columns(sint* sizes, sint count, sint len, allocator* alloc)
+{
+	slot_map map;
+	sint i;
+
+	assert((count > 0) && (count <= SLOT_MAP_MAX_COLUMNS));
+	memset(map.columns, 0, sizeof(map.columns));
+
+	for (i = 0; i < count; i++)
+	{
+		map.columns[i] = vector_init_alloc(sizes[i], len, alloc);
+		map.columns[i].shrink = CONTAINER_SHRINK_MANUAL;
+	}
+
+	map.slots = vector_init_alloc(sizeof(u32), len, alloc);
+	map.owners = vector_init_alloc(sizeof(u32), len, alloc);
+	map.column_count = count;
+	map.len = 0;
+	map.free = SLOT_MAP_INDEX_MASK;
+	return map;
+}
+
+void slot_map_destroy(slot_map* map)
+{
+	sint i;
+
+	for (i = 0; i < map->column_count; i++)
+		vector_destroy(&map->columns[i]);
+
+	vector_destroy(&map->slots);
+	vector_destroy(&map->owners);
+}
+
+void slot_map_reserve(slot_map* map, sint len)
+{
+	sint i;
+
+	for (i = 0; i < map->column_count; i++)
+		vector_reserve(&map->columns[i], len);
+
+	vector_reserve(&map->owners, len);
+}
+
+void slot_map_trim(slot_map* map)
+{
+	sint i;
+
+	for (i = 0; i < map->column_count; i++)
+		vector_trim(&map->columns[i]);
+
+	vector_trim(&map->owners);
+}
+
+u32 slot_map_push(slot_map* map, void* elem)
+{
+	u32* slots;
+	u32 slot;
+	sint i;
+
+	if (map->free == SLOT_MAP_INDEX_MASK)
+	{
+		u32 value = 1u << SLOT_MAP_INDEX_BITS;
+
+		assert((u32)map->slots.len < SLOT_MAP_INDEX_MASK);
+		slot = vector_push(&map->slots, &value);
+		slots = map->slots.data;
+	}
+	else
+	{
+		slot = map->free;
+		slots = map->slots.data;
+		map->free = slots[slot] & SLOT_MAP_INDEX_MASK;
+	}
+
+	slots[slot] = (slots[slot] & ~SLOT_MAP_INDEX_MASK) | (u32)map->len;
+	vector_push(&map->owners, &slot);
+
+	for (i = 0; i < map->column_count; i++)
+	{
+		vector* column = &map->columns[i];
+		void* _elem;
+
+		vector_reserve(column, map->len + 1);
+		_elem = vector_get(column, map->len);
+
+		if ((i == 0) && (elem != NULL))
+			memcpy(_elem, elem, column->elem_size);
+		else
+			memset(_elem, 0, column->elem_size);
+
+		column->len++;
+	}
+
+	map->len++;
+	return (slots[slot] & ~SLOT_MAP_INDEX_MASK) | slot;
+}
+
+sint slot_map_find(slot_map* map, u32 handle)
+{
+	u32 slot, value;
+
+	slot = handle & SLOT_MAP_INDEX_MASK;
+
+	if (slot >= (u32)map->slots.len)
+		return INVALID_INDEX;
+
+	value = ((u32*)map->slots.data)[slot];
+
+	if (((value ^ handle) & ~SLOT_MAP_INDEX_MASK) != 0)
+		return INVALID_INDEX;
+
+	return (sint)(value & SLOT_MAP_INDEX_MASK);
+}
+
+void* slot_map_get(slot_map* map, u32 handle)
+{
+	return slot_map_get_column(map, handle, 0);
+}
+
+void* slot_map_get_column(slot_map* map, u32 handle, sint column)
+{
+	sint idx = slot_map_find(map, handle);
+
+	if (idx == INVALID_INDEX)
+		return NULL;
+
+	return vector_get(&map->columns[column], idx);
+}
+
+sint slot_map_erase(slot_map* map, u32 handle)
+{
+	u32* slots, *owners;
+	u32 slot, generation;
+	sint i, idx, last;
+
+	idx = slot_map_find(map, handle);
+
+	if (idx == INVALID_INDEX)
+		return INVALID_INDEX;
+
+	slots = map->slots.data;
+	owners = map->owners.data;
+	slot = handle & SLOT_MAP_INDEX_MASK;
+	last = map->len - 1;
+
+	/* Swap remove, the slot of the moved elem is pointed at its new dense index. */
+	if (idx != last)
+	{
+		for (i = 0; i < map->column_count; i++)
+			memcpy(vector_get(&map->columns[i], idx), vector_get(&map->columns[i], last), map->columns[i].elem_size);
+
+		owners[idx] = owners[last];
+		slots[owners[idx]] = (slots[owners[idx]] & ~SLOT_MAP_INDEX_MASK) | (u32)idx;
+	}
+
+	for (i = 0; i < map->column_count; i++)
+		map->columns[i].len--;
+
+	map->owners.len--;
+	map->len--;
+
+	/* Generations wrap around to 1, skipping the never valid 0. */
+	generation = (slots[slot] >> SLOT_MAP_INDEX_BITS) + 1;
+
+	if (generation > (~0u >> SLOT_MAP_INDEX_BITS))
+		generation = 1;
+
+	slots[slot] = (generation << SLOT_MAP_INDEX_BITS) | map->free;
+	map->free = slot;
+
+	if (CONTAINER_SHOULD_SHRINK(&map->owners))
+		slot_map_trim(map);
+
+	return SUCCESS;
+}
+
+u32 slot_map_handle(slot_map* map, sint idx)
+{
+	u32 slot = ((u32*)map->owners.data)[idx];
+	return (((u32*)map->slots.data)[slot] & ~SLOT_MAP_INDEX_MASK) | slot;
+}
+
+
+
+/**************************************************************************************************/
+/*	bitset_t  */
+
+#if defined(PLATFORM_HAS_I64)
+#define BITSET_WORD_SHIFT 6
+#define BITSET_CTZ(word) ctz64(word)
+#define BITSET_POPCOUNT(word) popcount64(word)
+
+#else
+#define BITSET_WORD_SHIFT 5
+#define BITSET_CTZ(word) ctz(word)
+#define BITSET_POPCOUNT(word) popcount(word)
+
+#endif /* I64 */
+
+#define BITSET_WORDS(len) (((len) + BITSET_WORD_BITS - 1) >> BITSET_WORD_SHIFT)
+
+#define BITSET_AND 0
+#define BITSET_OR 1
+#define BITSET_ANDNOT 2
+
+
+
+bitset bitset_init(sint len)
+{
+	return bitset_init_alloc(len, NULL);
+}
+
+bitset bitset_init_alloc(sint len, allocator* alloc)
+{
+	bitset set = { NULL, 0, 0, alloc };
+	bitset_resize(&set, len);
+	return set;
+}
+
+void bitset_destroy(bitset* set)
+{
+	mem_free(set->alloc, set->words, sizeof(bitset_word) * set->cap);
+}
+
+/* Clears the bits of the last word past 'len'. */
+static void bitset_clear_tail(bitset* set)
+{
+	sint rest = set->len & (BITSET_WORD_BITS - 1);
+
+	if (rest != 0)
+		set->words[set->len >> BITSET_WORD_SHIFT] &= ((bitset_word)1 << rest) - 1;
+}
+
+void bitset_resize(bitset* set, sint len)
+{
+	sint words, new_words;
+
+	words = BITSET_WORDS(set->len);
+	new_words = BITSET_WORDS(len);
+
+	if (set->cap < new_words)
+	{
+		sint cap = get_container_capacity(new_words);
+
+		set->words = mem_realloc(set->alloc, set->words, sizeof(bitset_word) * set->cap,
+			sizeof(bitset_word) * cap);
+		set->cap = cap;
+	}
+
+	if (new_words > words)
+		memset(set->words + words, 0, sizeof(bitset_word) * (new_words - words));
+
+	set->len = len;
+	bitset_clear_tail(set);
+}
+
+sint bitset_get(bitset* set, sint idx)
+{
+	return (sint)((set->words[idx >> BITSET_WORD_SHIFT] >> (idx & (BITSET_WORD_BITS - 1))) & 1);
+}
+
+void bitset_set(bitset* set, sint idx)
+{
+	set->words[idx >> BITSET_WORD_SHIFT] |= (bitset_word)1 << (idx & (BITSET_WORD_BITS - 1));
+}
+
+void bitset_clear(bitset* set, sint idx)
+{
+	set->words[idx >> BITSET_WORD_SHIFT] &= ~((bitset_word)1 << (idx & (BITSET_WORD_BITS - 1)));
+}
+
+void bitset_fill(bitset* set, sint value)
+{
+	if (set->len == 0)
+		return;
+
+	memset(set->words, value ? 0xFF : 0, sizeof(bitset_word) * BITSET_WORDS(set->len));
+	bitset_clear_tail(set);
+}
+
+static void bitset_combine(bitset* dst, bitset* src, sint op)
+{
+	sint i, words, dst_words, src_words;
+
+	dst_words = BITSET_WORDS(dst->len);
+	src_words = BITSET_WORDS(src->len);
+	words = dst_words < src_words ? dst_words : src_words;
+	i = 0;
+
+	/* 16 bytes at a time, the rest word by word. */
+#if defined(PLATFORM_HAS_SSE2)
+	for (; i + (16 / (sint)sizeof(bitset_word)) <= words; i += 16 / sizeof(bitset_word))
+	{
+		__m128i a = _mm_loadu_si128((const __m128i*)(dst->words + i));
+		__m128i b = _mm_loadu_si128((const __m128i*)(src->words + i));
+
+		if (op == BITSET_AND)
+			a = _mm_and_si128(a, b);
+		else if (op == BITSET_OR)
+			a = _mm_or_si128(a, b);
+		else
+			a = _mm_andnot_si128(b, a);
+
+		_mm_storeu_si128((__m128i*)(dst->words + i), a);
+	}
+
+#elif defined(PLATFORM_HAS_NEON)
+	for (; i + (16 / (sint)sizeof(bitset_word)) <= words; i += 16 / sizeof(bitset_word))
+	{
+		uint8x16_t a = vld1q_u8((const u8*)(dst->words + i));
+		uint8x16_t b = vld1q_u8((const u8*)(src->words + i));
+
+		if (op == BITSET_AND)
+			a = vandq_u8(a, b);
+		else if (op == BITSET_OR)
+			a = vorrq_u8(a, b);
+		else
+			a = vbicq_u8(a, b);
+
+		vst1q_u8((u8*)(dst->words + i), a);
+	}
+
+#endif
+
+	for (; i < words; i++)
+	{
+		if (op == BITSET_AND)
+			dst->words[i] &= src->words[i];
+		else if (op == BITSET_OR)
+			dst->words[i] |= src->words[i];
+		else
+			dst->words[i] &= ~src->words[i];
+	}
+
+	if ((op == BITSET_AND) && (dst_words > words))
+		memset(dst->words + words, 0, sizeof(bitset_word) * (dst_words - words));
+
+	/* 'src' may be longer than 'dst'. */
+	if (op == BITSET_OR)
+		bitset_clear_tail(dst);
+}
+
+void bitset_and(bitset* dst, bitset* src)
+{
+	bitset_combine(dst, src, BITSET_AND);
+}
+
+void bitset_or(bitset* dst, bitset* src)
+{
+	bitset_combine(dst, src, BITSET_OR);
+}
+
+void bitset_andnot(bitset* dst, bitset* src)
+{
+	bitset_combine(dst, src, BITSET_ANDNOT);
+}
+
+sint bitset_count(bitset* set)
+{
+	sint i, words, count;
+
+	words = BITSET_WORDS(set->len);
+	i = 0;
+	count = 0;
+
+	/* Per byte counts summed up with a SAD, or NEON's byte popcount. */
+#if defined(PLATFORM_HAS_SSE2)
+	{
+		__m128i sum = _mm_setzero_si128();
+
+		for (; i + (16 / (sint)sizeof(bitset_word)) <= words; i += 16 / sizeof(bitset_word))
+		{
+			__m128i v = _mm_loadu_si128((const __m128i*)(set->words + i));
+
+			v = _mm_sub_epi8(v, _mm_and_si128(_mm_srli_epi64(v, 1), _mm_set1_epi8(0x55)));
+			v = _mm_add_epi8(_mm_and_si128(v, _mm_set1_epi8(0x33)),
+				_mm_and_si128(_mm_srli_epi64(v, 2), _mm_set1_epi8(0x33)));
+			v = _mm_and_si128(_mm_add_epi8(v, _mm_srli_epi64(v, 4)), _mm_set1_epi8(0x0F));
+			sum = _mm_add_epi64(sum, _mm_sad_epu8(v, _mm_setzero_si128()));
+		}
+
+		count = _mm_cvtsi128_si32(sum) + _mm_cvtsi128_si32(_mm_srli_si128(sum, 8));
+	}
+
+#elif defined(PLATFORM_HAS_NEON)
+	{
+		uint64x2_t sum = vdupq_n_u64(0);
+
+		for (; i + (16 / (sint)sizeof(bitset_word)) <= words; i += 16 / sizeof(bitset_word))
+			sum = vpadalq_u32(sum, vpaddlq_u16(vpaddlq_u8(vcntq_u8(vld1q_u8((const u8*)(set->words + i))))));
+
+		count = (sint)vaddvq_u64(sum);
+	}
+
+#endif
+
+	for (; i < words; i++)
+		count += BITSET_POPCOUNT(set->words[i]);
+
+	return count;
+}
+
+sint bitset_next(bitset* set, sint idx)
+{
+	sint w, words;
+	bitset_word word;
+
+	if (idx >= set->len)
+		return INVALID_INDEX;
+
+	words = BITSET_WORDS(set->len);
+	w = idx >> BITSET_WORD_SHIFT;
+	word = set->words[w] & (~(bitset_word)0 << (idx & (BITSET_WORD_BITS - 1)));
+
+	while (word == 0)
+	{
+		if (++w == words)
+			return INVALID_INDEX;
+
+		word = set->words[w];
+	}
+
+	return (w << BITSET_WORD_SHIFT) + BITSET_CTZ(word);
+}
+
+sint bitset_next_zero(bitset* set, sint idx)
+{
+	sint w, words;
+	bitset_word word;
+
+	if (idx >= set->len)
+		return INVALID_INDEX;
+
+	words = BITSET_WORDS(set->len);
+	w = idx >> BITSET_WORD_SHIFT;
+	word = ~set->words[w] & (~(bitset_word)0 << (idx & (BITSET_WORD_BITS - 1)));
+
+	while (word == 0)
+	{
+		if (++w == words)
+			return INVALID_INDEX;
+
+		word = ~set->words[w];
+	}
+
+	/* The cleared tail bits of the last word are not part of the set. */
+	idx = (w << BITSET_WORD_SHIFT) + BITSET_CTZ(word);
+	return idx < set->len ? idx : INVALID_INDEX;
+}
+
+
+
+/**************************************************************************************************/
+/*	priority_queue_t  */
+
+#define HEAP_ARITY 4
+
+static void priority_queue_sift_up(priority_queue* queue, sint idx, heap_node node)
+{
+	heap_node* nodes = queue->nodes.data;
+	sint* positions = queue->positions.data;
+
+	while (idx > 0)
+	{
+		sint parent = (idx - 1) / HEAP_ARITY;
+
+		if (!(node.priority < nodes[parent].priority))
+			break;
+
+		nodes[idx] = nodes[parent];
+		positions[nodes[idx].slot] = idx;
+		idx = parent;
+	}
+
+	nodes[idx] = node;
+	positions[node.slot] = idx;
+}
+
+static void priority_queue_sift_down(priority_queue* queue, sint idx, heap_node node)
+{
+	heap_node* nodes = queue->nodes.data;
+	sint* positions = queue->positions.data;
+	sint len = queue->nodes.len;
+
+	for (;;)
+	{
+		sint first, last, best, i;
+
+		first = (idx * HEAP_ARITY) + 1;
+
+		if (first >= len)
+			break;
+
+		last = first + HEAP_ARITY < len ? first + HEAP_ARITY : len;
+
+		for (i = first + 1, best = first; i < last; i++)
+			best = nodes[i].priority < nodes[best].priority ? i : best;
+
+		if (!(nodes[best].priority < node.priority))
+			break;
+
+		nodes[idx] = nodes[best];
+		positions[nodes[idx].slot] = idx;
+		idx = best;
+	}
+
+	nodes[idx] = node;
+	positions[node.slot] = idx;
+}
+
+/* Moves the node at 'idx' up or down after its priority changed. */
+static void priority_queue_fix(priority_queue* queue, sint idx)
+{
+	heap_node node = ((heap_node*)queue->nodes.data)[idx];
+
+	if ((idx > 0) && (node.priority < ((heap_node*)queue->nodes.data)[(idx - 1) / HEAP_ARITY].priority))
+		priority_queue_sift_up(queue, idx, node);
+	else
+		priority_queue_sift_down(queue, idx, node);
+}
+
+static void priority_queue_heapify(priority_queue* queue)
+{
+	sint i;
+
+	if (queue->nodes.len < 2)
+		return;
+
+	/* Sift down every parent, starting at the last one. */
+	for (i = (queue->nodes.len - 2) / HEAP_ARITY; i >= 0; i--)
+		priority_queue_sift_down(queue, i, ((heap_node*)queue->nodes.data)[i]);
+}
+
+/* Stores the elem in a free slot and appends its node without sifting. */
+static sint priority_queue_append(priority_queue* queue, void* elem, flt priority)
+{
+	heap_node node;
+	sint slot, idx;
+
+	if (queue->free != INVALID_INDEX)
+	{
+		slot = queue->free;
+		queue->free = *(sint*)vector_get(&queue->positions, slot);
+		memcpy(vector_get(&queue->elems, slot), elem, queue->elems.elem_size);
+	}
+	else
+	{
+		slot = vector_push(&queue->elems, elem);
+		vector_push(&queue->positions, &slot);
+	}
 
-	hash = map->hash(bucket);
-	_bucket = flat_hashmap_get_index(map, hash, bucket, &idx);
+	node.priority = priority;
+	node.slot = (u32)slot;
+	idx = vector_push(&queue->nodes, &node);
+	*(sint*)vector_get(&queue->positions, slot) = idx;
+	return slot;
+}
 
-	if (_bucket != NULL)
-		return _bucket;
+/* Takes the node at 'idx' out of the heap and frees its slot. */
+static void priority_queue_erase(priority_queue* queue, sint idx, void* out_elem)
+{
+	heap_node* nodes = queue->nodes.data;
+	sint slot = (sint)nodes[idx].slot;
 
-	mask = map->cap - 1;
-	distance = ((map->cap + idx) - (hash & mask)) & mask;
+	if (out_elem != NULL)
+		memcpy(out_elem, vector_get(&queue->elems, slot), queue->elems.elem_size);
 
-	for (;; idx = (idx + 1) & mask, distance++)
-	{
-		sint _distance;
+	*(sint*)vector_get(&queue->positions, slot) = queue->free;
+	queue->free = slot;
+	queue->nodes.len--;
 
-		_bucket = (void*)((uptr)map->buckets + ((uptr)idx * map->bucket_size));
-		_distance = map->info[idx];
+	if (idx < queue->nodes.len)
+	{
+		nodes[idx] = nodes[queue->nodes.len];
+		priority_queue_fix(queue, idx);
+	}
+}
 
-		if (_distance == U8_MAX)
-		{
-			memcpy(_bucket, bucket, map->bucket_size);
-			map->info[idx] = distance;
-			map->len++;
-			return NULL;
-		}
-		else if (distance > _distance)
-		{
-			void* tmp_one, * tmp_two;
+priority_queue priority_queue_init(sint size, sint len)
+{
+	return priority_queue_init_alloc(size, len, NULL);
+}
 
-			tmp_one = (void*)((uptr)map->buckets + ((uptr)map->cap * map->bucket_size));
-			tmp_two = (void*)((uptr)tmp_one + map->bucket_size);
+priority_queue priority_queue_init_alloc(sint size, sint len, allocator* alloc)
+{
+	priority_queue queue;
 
-			memcpy(tmp_one, _bucket, map->bucket_size);
-			memcpy(_bucket, bucket, map->bucket_size);
-			memcpy(tmp_two, tmp_one, map->bucket_size);
+	queue.nodes = vector_init_alloc(sizeof(heap_node), len, alloc);
+	queue.elems = vector_init_alloc(size, len, alloc);
+	queue.positions = vector_init_alloc(sizeof(sint), len, alloc);
+	queue.free = INVALID_INDEX;
+	return queue;
+}
 
-			bucket = tmp_two;
-			map->info[idx] = distance;
-			distance = _distance;
-		}
-	}
+void priority_queue_destroy(priority_queue* queue)
+{
+	vector_destroy(&queue->nodes);
+	vector_destroy(&queue->elems);
+	vector_destroy(&queue->positions);
 }
 
-sint flat_hashmap_pop(flat_hashmap* map, void* bucket, void* out_key)
+void priority_queue_reserve(priority_queue* queue, sint len)
 {
-	sint mask, hash, idx, next;
+	vector_reserve(&queue->nodes, len);
+	vector_reserve(&queue->elems, len);
+	vector_reserve(&queue->positions, len);
+}
 
-	hash = map->hash(bucket);
+sint priority_queue_push(priority_queue* queue, void* elem, flt priority)
+{
+	sint slot = priority_queue_append(queue, elem, priority);
 
-	if (flat_hashmap_get_index(map, hash, bucket, &idx) == NULL)
-		return INVALID_INDEX;
+	priority_queue_fix(queue, queue->nodes.len - 1);
+	return slot;
+}
 
-	memcpy(out_key, (void*)((uptr)map->buckets + ((uptr)idx * map->bucket_size)), map->bucket_size);
+void priority_queue_push_many(priority_queue* queue, void* elems, flt* priorities, sint count,
+	sint* out_handles)
+{
+	sint i, len, slot;
 
-	mask = map->cap - 1;
+	len = queue->nodes.len;
+	priority_queue_reserve(queue, len + count);
 
-	for (next = (idx + 1) & mask;; idx = next, next = (next + 1) & mask)
+	for (i = 0; i < count; i++)
 	{
-		void* _bucket;
-		void* next_bucket;
-		sint next_distance;
+		slot = priority_queue_append(queue, (void*)((uptr)elems + ((uptr)i * queue->elems.elem_size)),
+			priorities[i]);
 
-		next_distance = map->info[next];
+		/* Small batches are sifted in, large ones rebuild the heap in linear time. */
+		if (count < len)
+			priority_queue_fix(queue, queue->nodes.len - 1);
 
-		if ((next_distance == U8_MAX) | (next_distance == 0))
-		{
-			map->info[idx] = U8_MAX;
-			map->len--;
-			break;
-		}
+		if (out_handles != NULL)
+			out_handles[i] = slot;
+	}
 
-		_bucket = (void*)((uptr)map->buckets + ((uptr)idx * map->bucket_size));
-		next_bucket = (void*)((uptr)_bucket + map->bucket_size);
+	if (count >= len)
+		priority_queue_heapify(queue);
+}
 
-		memcpy(_bucket, next_bucket, map->bucket_size);
-		map->info[idx] = next_distance - 1;
-	}
+sint priority_queue_top(priority_queue* queue)
+{
+	if (queue->nodes.len == 0)
+		return INVALID_INDEX;
 
-	flat_hashmap_trim(map);
+	return (sint)((heap_node*)queue->nodes.data)[0].slot;
+}
+
+void* priority_queue_get(priority_queue* queue, sint handle)
+{
+	return vector_get(&queue->elems, handle);
+}
+
+flt priority_queue_priority(priority_queue* queue, sint handle)
+{
+	sint idx = *(sint*)vector_get(&queue->positions, handle);
+	return ((heap_node*)queue->nodes.data)[idx].priority;
+}
+
+sint priority_queue_pop(priority_queue* queue, void* out_elem)
+{
+	if (queue->nodes.len == 0)
+		return INVALID_INDEX;
 
+	priority_queue_erase(queue, 0, out_elem);
 	return SUCCESS;
 }
 
+void priority_queue_update_priority(priority_queue* queue, sint handle, flt priority)
+{
+	sint idx = *(sint*)vector_get(&queue->positions, handle);
 
+	((heap_node*)queue->nodes.data)[idx].priority = priority;
+	priority_queue_fix(queue, idx);
+}
 
-/**************************************************************************************************/
-/*	flat_ordered_hashmap_t  */
+void priority_queue_remove(priority_queue* queue, sint handle, void* out_elem)
+{
+	priority_queue_erase(queue, *(sint*)vector_get(&queue->positions, handle), out_elem);
+}
 
-flat_ordered_hashmap flat_ordered_hashmap_init(sint size, sint len, sint(*hash)(void* a), sint(*cmp)(void* a, void* b))
+void priority_queue_reprioritize(priority_queue* queue, priorityfunc func, void* user)
 {
-	sint sz, cap, rest;
-	flat_ordered_hashmap map;
+	heap_node* nodes = queue->nodes.data;
+	sint i;
 
-	cap = get_container_capacity(len);
-	sz = (cap * size);
-	rest = sz % sizeof(sint);
+	for (i = 0; i < queue->nodes.len; i++)
+		nodes[i].priority = func(vector_get(&queue->elems, (sint)nodes[i].slot), user);
 
-	if (rest != 0)
-		sz += sizeof(sint) - rest;
+	priority_queue_heapify(queue);
+}
 
-	map.dense = malloc(sz + (sizeof(sint) * cap) + cap);
-	map.sparse = (sint*)((uptr)map.dense + sz);
-	map.info = (u8*)(map.sparse + cap);
-	map.bucket_size = size;
-	map.cap = cap;
-	map.len = 0;
-	map.hash = hash;
-	map.cmp = cmp;
 
-	memset(map.info, -1, map.cap);
-	return map;
+
+/**************************************************************************************************/
+/*	radix_sort  */
+
+#define RADIX_BUCKETS 256
+
+/* Keys are read byte by byte in little endian order. */
+typedef struct radix_pass
+{
+	u8* src;
+	u8* dst;
+	sint size;
+	sint len;
+	sint key;
+	sint tasks;
+	u32* counts;
+} radix_pass;
+
+static sint radix_task_begin(radix_pass* pass, sint task)
+{
+	return (sint)(((uptr)pass->len * task) / pass->tasks);
 }
 
-void flat_ordered_hashmap_destroy(flat_ordered_hashmap* map)
+static void radix_count_task(void* data, sint task)
 {
-	free(map->dense);
+	radix_pass* pass = data;
+	const u8* key, *end;
+	u32* counts;
+
+	key = pass->src + pass->key + (uptr)radix_task_begin(pass, task) * pass->size;
+	end = pass->src + pass->key + (uptr)radix_task_begin(pass, task + 1) * pass->size;
+	counts = pass->counts + (uptr)task * RADIX_BUCKETS;
+
+	memset(counts, 0, sizeof(u32) * RADIX_BUCKETS);
+
+	for (; key < end; key += pass->size)
+		counts[*key]++;
 }
 
-void flat_ordered_hashmap_reserve(flat_ordered_hashmap* map, sint len)
+static void radix_scatter_task(void* data, sint task)
 {
-	if (len > (map->cap - (map->cap / 4)))
+	radix_pass* pass = data;
+	const u8* src, *end;
+	u8* dst;
+	u32* offsets;
+	sint key, size;
+
+	size = pass->size;
+	src = pass->src + (uptr)radix_task_begin(pass, task) * size;
+	end = pass->src + (uptr)radix_task_begin(pass, task + 1) * size;
+	dst = pass->dst;
+	key = pass->key;
+	offsets = pass->counts + (uptr)task * RADIX_BUCKETS;
+
+	/* Constant sizes let the copies compile to plain moves. */
+	switch (size)
 	{
-		flat_ordered_hashmap new_map;
-		sint i;
+	case 4:
+		for (; src < end; src += 4)
+			memcpy(dst + (uptr)offsets[src[key]]++ * 4, src, 4);
+		break;
 
-		new_map = flat_ordered_hashmap_init(map->bucket_size, len * 2, map->hash, map->cmp);
+	case 8:
+		for (; src < end; src += 8)
+			memcpy(dst + (uptr)offsets[src[key]]++ * 8, src, 8);
+		break;
 
-		for (i = 0; i < map->len; i++)
-		{
-			void* _bucket = (void*)((uptr)map->dense + (uptr)map->bucket_size * i);
-			flat_ordered_hashmap_push(&new_map, _bucket);
-		}
+	case 16:
+		for (; src < end; src += 16)
+			memcpy(dst + (uptr)offsets[src[key]]++ * 16, src, 16);
+		break;
 
-		flat_ordered_hashmap_destroy(map);
-		*map = new_map;
+	default:
+		for (; src < end; src += size)
+			memcpy(dst + (uptr)offsets[src[key]]++ * size, src, size);
+		break;
 	}
 }
 
-void flat_ordered_hashmap_trim(flat_ordered_hashmap* map)
+/* Turns the counts of every task into its scatter offsets. Returns 0 if all elems fall into one
+ * bucket, the pass can be skipped then. */
+static sint radix_offsets(radix_pass* pass)
 {
-	if ((map->cap - (map->cap - (map->cap / 4))) > map->len)
+	sint b, t;
+	u32 sum;
+
+	for (b = 0, sum = 0; b < RADIX_BUCKETS; b++)
 	{
-		flat_ordered_hashmap new_map;
-		sint i;
+		u32 total = 0;
 
-		new_map = flat_ordered_hashmap_init(map->bucket_size, map->len, map->hash, map->cmp);
+		for (t = 0; t < pass->tasks; t++)
+			total += pass->counts[t * RADIX_BUCKETS + b];
 
-		for (i = 0; i < map->len; i++)
+		if (total == (u32)pass->len)
+			return 0;
+
+		for (t = 0; t < pass->tasks; t++)
 		{
-			void* _bucket = (void*)((uptr)map->dense + ((uptr)map->bucket_size * i));
-			flat_ordered_hashmap_push(&new_map, _bucket);
+			u32 count = pass->counts[t * RADIX_BUCKETS + b];
+
+			pass->counts[t * RADIX_BUCKETS + b] = sum;
+			sum += count;
 		}
+	}
+
+	return 1;
+}
+
+/* See float_order_bits, 'restore' flips them back. */
+static void radix_flip_floats(u8* elems, sint size, sint len, sint key_offset, sint restore)
+{
+	u8* key, *end;
+
+	end = elems + key_offset + (uptr)len * size;
+
+	for (key = elems + key_offset; key < end; key += size)
+	{
+		u32 bits;
 
-		flat_ordered_hashmap_destroy(map);
-		*map = new_map;
+		memcpy(&bits, key, sizeof(u32));
+
+		if (restore)
+			bits = (bits & 0x80000000u) ? (bits & 0x7FFFFFFFu) : ~bits;
+		else
+			bits = float_order_bits(bits);
+
+		memcpy(key, &bits, sizeof(u32));
 	}
 }
 
-void* flat_ordered_hashmap_get_index(flat_ordered_hashmap* map, sint hash, sint* bucket, sint* out_index)
+static void radix_sort_passes(void* elems, sint size, sint len, sint key_offset, sint key_bytes,
+	allocator* scratch, sint tasks, dispatchfunc dispatch)
 {
-	int mask, idx, distance;
+	radix_pass pass;
+	uptr buffer_size, counts_offset, counts_size;
+	u8* buffer;
+	u32* counts;
+	sint p;
 
-	mask = map->cap - 1;
-	idx = hash & mask;
-	distance = 0;
+	if (len < 2)
+		return;
 
-	for (;; idx = (idx + 1) & mask, distance++)
+	if ((tasks < 2) | (dispatch == NULL))
+		tasks = 1;
+
+	/* A single task counts every key byte in one read, the counts do not depend on the order. */
+	buffer_size = (uptr)len * size;
+	counts_size = sizeof(u32) * RADIX_BUCKETS * (tasks == 1 ? key_bytes : tasks);
+
+	/* Odd elem sizes would leave the counts misaligned behind the elems. */
+	counts_offset = (buffer_size + 15) & ~(uptr)15;
+	buffer = mem_alloc(scratch, counts_offset + counts_size);
+	counts = (u32*)(buffer + counts_offset);
+
+	pass.src = elems;
+	pass.dst = buffer;
+	pass.size = size;
+	pass.len = len;
+	pass.tasks = tasks;
+
+	if (tasks == 1)
 	{
-		void* _bucket;
-		sint _distance;
+		const u8* key, *end;
 
-		_distance = map->info[idx];
+		memset(counts, 0, counts_size);
+		end = pass.src + key_offset + buffer_size;
 
-		if ((_distance == 0xFF) | (distance > _distance))
+		for (key = pass.src + key_offset; key < end; key += size)
 		{
-			*out_index = idx;
-			return NULL;
+			for (p = 0; p < key_bytes; p++)
+				counts[p * RADIX_BUCKETS + key[p]]++;
 		}
+	}
 
-		_bucket = (void*)((uptr)map->dense + ((uptr)map->sparse[idx] * map->bucket_size));
+	for (p = 0; p < key_bytes; p++)
+	{
+		u8* tmp;
 
-		if (map->cmp(bucket, _bucket) == 0)
+		pass.key = key_offset + p;
+
+		if (tasks == 1)
+			pass.counts = counts + p * RADIX_BUCKETS;
+		else
 		{
-			*out_index = idx;
-			return _bucket;
+			pass.counts = counts;
+			dispatch(radix_count_task, &pass, tasks);
 		}
+
+		if (!radix_offsets(&pass))
+			continue;
+
+		if (tasks == 1)
+			radix_scatter_task(&pass, 0);
+		else
+			dispatch(radix_scatter_task, &pass, tasks);
+
+		tmp = pass.src;
+		pass.src = pass.dst;
+		pass.dst = tmp;
 	}
+
+	if (pass.src != elems)
+		memcpy(elems, pass.src, buffer_size);
+
+	mem_free(scratch, buffer, counts_offset + counts_size);
 }
 
-void* flat_ordered_hashmap_get(flat_ordered_hashmap* map, void* bucket)
+void radix_sort(void* elems, sint size, sint len, sint key_offset, sint key_type, allocator* scratch)
 {
-	sint idx;
-	return flat_ordered_hashmap_get_index(map, map->hash(bucket), bucket, &idx);
+	radix_sort_parallel(elems, size, len, key_offset, key_type, scratch, 1, NULL);
 }
 
-void* flat_ordered_hashmap_push(flat_ordered_hashmap* map, void* bucket)
+void radix_sort_parallel(void* elems, sint size, sint len, sint key_offset, sint key_type,
+	allocator* scratch, sint tasks, dispatchfunc dispatch)
 {
-	sint mask, hash, idx, distance, tmp;
-	void* _bucket;
+	sint key_bytes = key_type == RADIX_KEY_U64 ? 8 : 4;
 
-	flat_ordered_hashmap_reserve(map, map->len + 1);
+	if (key_type == RADIX_KEY_F32)
+		radix_flip_floats(elems, size, len, key_offset, 0);
 
-	hash = map->hash(bucket);
-	_bucket = flat_ordered_hashmap_get_index(map, hash, bucket, &idx);
+	radix_sort_passes(elems, size, len, key_offset, key_bytes, scratch, tasks, dispatch);
 
-	if (_bucket != NULL)
-		return _bucket;
+	if (key_type == RADIX_KEY_F32)
+		radix_flip_floats(elems, size, len, key_offset, 1);
+}
 
-	mask = map->cap - 1;
-	distance = ((map->cap + idx) - (hash & mask)) & mask;
+void radix_sort_indices(void* elems, sint size, sint len, sint key_offset, sint key_type,
+	u32* out_indices, allocator* scratch)
+{
+	sint i, key_bytes, pair_size;
+	u8* pairs;
+
+	/* Sort (key, index) pairs instead of chasing the elems in every pass. */
+	key_bytes = key_type == RADIX_KEY_U64 ? 8 : 4;
+	pair_size = key_bytes * 2;
+	pairs = mem_alloc(scratch, (uptr)len * pair_size);
 
-	for (tmp = -1;; idx = (idx + 1) & mask, distance++)
+	for (i = 0; i < len; i++)
 	{
-		sint _distance = map->info[idx];
+		u8* pair = pairs + (uptr)i * pair_size;
+		u32 idx = (u32)i;
 
-		if (_distance == 0xFF)
-		{
-			if (tmp == -1)
-			{
-				/* Add bucket to dense */
-				_bucket = (void*)((size_t)map->dense + ((size_t)map->len * map->bucket_size));
-				memcpy(_bucket, bucket, map->bucket_size);
-				map->sparse[idx] = map->len++;
-			}
-			else
-			{
-				/* Replace index */
-				map->sparse[idx] = tmp;
-			}
+		memcpy(pair, (u8*)elems + (uptr)i * size + key_offset, key_bytes);
+		memcpy(pair + key_bytes, &idx, sizeof(u32));
+	}
 
-			map->info[idx] = distance;
-			return NULL;
-		}
-		else if (distance > _distance)
-		{
-			sint tmp_x = map->sparse[idx];
+	if (key_type == RADIX_KEY_F32)
+		radix_flip_floats(pairs, pair_size, len, 0, 0);
 
-			if (tmp == -1)
-			{
-				/* Add bucket to dense */
-				_bucket = (void*)((size_t)map->dense + ((size_t)map->len * map->bucket_size));
-				memcpy(_bucket, bucket, map->bucket_size);
-				map->sparse[idx] = map->len++;
-			}
-			else
-			{
-				/* Replace index */
-				map->sparse[idx] = tmp;
-			}
+	radix_sort_passes(pairs, pair_size, len, 0, key_bytes, scratch, 1, NULL);
 
-			tmp = tmp_x;
-			map->info[idx] = distance;
-			distance = _distance;
-		}
-	}
+	for (i = 0; i < len; i++)
+		memcpy(out_indices + i, pairs + (uptr)i * pair_size + key_bytes, sizeof(u32));
+
+	mem_free(scratch, pairs, (uptr)len * pair_size);
 }
 
-sint flat_ordered_hashmap_pop(flat_ordered_hashmap* map, void* bucket, void* out_bucket)
+void vector_radix_sort(vector* vec, sint key_offset, sint key_type, allocator* scratch)
 {
-	sint hash, idx, mask, next, rest, dense_idx;
-	void* first;
-
-	hash = map->hash(bucket);
+	radix_sort(vec->data, vec->elem_size, vec->len, key_offset, key_type, scratch);
+}
 
-	if (flat_ordered_hashmap_get_index(map, hash, bucket, &idx) == NULL)
-		return INVALID_INDEX;
 
-	dense_idx = map->sparse[idx];
-	first = (void*)((size_t)map->dense + ((size_t)dense_idx * map->bucket_size));
-	rest = (size_t)(map->len - dense_idx - 1) * map->bucket_size;
 
-	memcpy(out_bucket, first, map->bucket_size);
-	memmove(first, (void*)((size_t)first + map->bucket_size), rest);
-	map->len--;
+/**************************************************************************************************/
+/*	serialized tables  */
 
-	mask = map->cap - 1;
+#define SERIALIZED_ROUND(size) (((size) + SERIALIZED_ALIGN - 1) & ~(uptr)(SERIALIZED_ALIGN - 1))
 
-	for (next = (idx + 1) & mask;; idx = next, next = (next + 1) & mask)
+static uptr serialized_write(void* out, u32 kind, sint bucket_size, sint len, sint cap, sint frozen,
+	const void* buckets, uptr buckets_size, const void* info, uptr info_size)
+{
+	serialized_table header;
+	uptr size;
+
+	header.magic = SERIALIZED_MAGIC;
+	header.kind = kind;
+	header.bucket_size = (u32)bucket_size;
+	header.len = (u32)len;
+	header.cap = (u32)cap;
+	header.frozen = (u32)frozen;
+	header.buckets = (u32)SERIALIZED_ROUND(sizeof(serialized_table));
+	header.info = info_size == 0 ? 0 : (u32)(header.buckets + SERIALIZED_ROUND(buckets_size));
+	size = (info_size == 0 ? header.buckets + buckets_size : header.info + info_size);
+	header.size = (u32)size;
+
+	if (out != NULL)
 	{
-		sint next_distance = map->info[next];
+		memset(out, 0, size);
+		memcpy(out, &header, sizeof(serialized_table));
 
-		if ((next_distance == 0xFF) | (next_distance == 0))
-		{
-			map->info[idx] = 0xFF;
-			break;
-		}
+		if (buckets_size != 0)
+			memcpy((u8*)out + header.buckets, buckets, buckets_size);
 
-		map->sparse[idx] = map->sparse[next];
-		map->info[idx] = next_distance - 1;
+		if (info_size != 0)
+			memcpy((u8*)out + header.info, info, info_size);
 	}
 
-	flat_ordered_hashmap_trim(map);
+	return size;
+}
+
+/* Returns the header if 'data' holds a table of 'kind' with buckets of 'bucket_size', whose
+ * buckets section lies within the bytes. */
+static const serialized_table* serialized_read(const void* data, uptr size, u32 kind, sint bucket_size)
+{
+	const serialized_table* header = data;
+
+	if ((((uptr)data & (SERIALIZED_ALIGN - 1)) != 0) | (size < sizeof(serialized_table)))
+		return NULL;
+
+	if ((header->magic != SERIALIZED_MAGIC) | (header->kind != kind) |
+		(header->bucket_size != (u32)bucket_size) | (header->size > size))
+		return NULL;
+
+	/* Divided instead of multiplied, so crafted counts cannot wrap around. */
+	if ((header->len > header->cap) | (header->buckets < sizeof(serialized_table)) |
+		((header->buckets & (SERIALIZED_ALIGN - 1)) != 0) | (header->buckets > header->size))
+		return NULL;
+
+	if ((header->bucket_size != 0) &&
+		(header->cap > (header->size - header->buckets) / header->bucket_size))
+		return NULL;
+
+	return header;
+}
+
+uptr flat_map_serialize(flat_map* map, void* out)
+{
+	/* The frozen layout has the unused slot 0 in front. */
+	sint slots = map->frozen ? map->len + 1 : map->len;
+
+	return serialized_write(out, SERIALIZED_FLAT_MAP, map->bucket_size, map->len, slots, map->frozen,
+		map->buckets, (uptr)slots * map->bucket_size, NULL, 0);
+}
+
+uptr flat_hashmap_serialize(flat_hashmap* map, void* out)
+{
+	flat_hashmap_finish_migration(map);
+
+	return serialized_write(out, SERIALIZED_FLAT_HASHMAP, map->bucket_size, map->len, map->cap, 0,
+		map->buckets, (uptr)map->cap * map->bucket_size, map->info, sizeof(u32) * map->cap);
+}
+
+sint flat_map_view_init(flat_map_view* view, const void* data, uptr size, sint bucket_size, cmpfunc cmp)
+{
+	const serialized_table* header = serialized_read(data, size, SERIALIZED_FLAT_MAP, bucket_size);
+
+	/* The frozen layout has the unused slot 0 in front. */
+	if ((header == NULL) || (header->frozen > 1) || (header->cap != header->len + header->frozen))
+		return INVALID_INDEX;
 
+	/* The map is never written through, the allocator is never used. */
+	memset(&view->map, 0, sizeof(flat_map));
+	view->map.buckets = (u8*)data + header->buckets;
+	view->map.bucket_size = bucket_size;
+	view->map.len = (sint)header->len;
+	view->map.cap = (sint)header->cap;
+	view->map.cmp = cmp;
+	view->map.frozen = (sint)header->frozen;
 	return SUCCESS;
 }
 
+sint flat_hashmap_view_init(flat_hashmap_view* view, const void* data, uptr size, sint bucket_size,
+	hashfunc hash, cmpfunc cmp)
+{
+	const serialized_table* header = serialized_read(data, size, SERIALIZED_FLAT_HASHMAP, bucket_size);
 
+	if ((header == NULL) || (header->frozen != 0) || (header->cap == 0) ||
+		((header->cap & (header->cap - 1)) != 0))
+		return INVALID_INDEX;
 
-/**************************************************************************************************/
-/*	pool_t  */
+	if ((header->info < header->buckets) || ((header->info & (SERIALIZED_ALIGN - 1)) != 0) ||
+		(header->info > header->size) || (header->cap > (header->size - header->info) / sizeof(u32)))
+		return INVALID_INDEX;
+
+	memset(&view->map, 0, sizeof(flat_hashmap));
+	view->map.buckets = (u8*)data + header->buckets;
+	view->map.info = (u32*)((u8*)data + header->info);
+	view->map.bucket_size = bucket_size;
+	view->map.len = (sint)header->len;
+	view->map.cap = (sint)header->cap;
+	view->map.hash = hash;
+	view->map.cmp = cmp;
+	return SUCCESS;
+}
 
+const void* flat_map_view_get(flat_map_view* view, void* bucket)
+{
+	return flat_map_get(&view->map, bucket);
+}
 
+const void* flat_hashmap_view_get(flat_hashmap_view* view, void* bucket)
+{
+	return flat_hashmap_get(&view->map, bucket);
+}
@@ -3,6 +3,7 @@
 
 
 #include "core.h"
+#include "allocator.h"
 
 
 
@@ -15,79 +16,253 @@ typedef sint(*cmpfunc)(void*, void*);
 
 /**************************************************************************************************/
 
-/* 16 - 24 bytes. */
+/* Erasing shrinks a container once its len drops below cap >> 'shrink', *_trim then halves the
+ * capacity at least and leaves the load at most 1/2. A larger 'shrink' widens the band between
+ * growing and shrinking for sizes that oscillate. CONTAINER_SHRINK_MANUAL only shrinks on explicit
+ * *_trim calls, e.g. once at the end of a frame. */
+#define CONTAINER_SHRINK_MANUAL 0
+#define CONTAINER_SHRINK_DEFAULT 2
+
+#define CONTAINER_SHOULD_SHRINK(c) (((c)->shrink != 0) & ((c)->len < ((c)->cap >> (c)->shrink)))
+
+
+
+/**************************************************************************************************/
+
+/* 'alloc' is NULL for the heap. 20 - 32 bytes. */
 typedef struct vector
 {
 	void* data;
 	sint elem_size;
 	sint len;
 	sint cap;
+	sint shrink;
+	allocator* alloc;
 } vector;
 
 
 
 /*************************************************************************************************/
 
-/* 12 - 16 bytes. */
+/* Strings shorter than STRING_SMALL_CAP bytes are stored inline in 'buf.small' and 'cap' is 0,
+ * longer ones are allocated from 'alloc' in 'buf.data'. Access the characters through string_get.
+ * 40 - 48 bytes. */
+#define STRING_SMALL_CAP 24
+
 typedef struct string
 {
-	char* data;
+	union
+	{
+		char* data;
+		char small[STRING_SMALL_CAP];
+	} buf;
 	sint len;
 	sint cap;
+	sint shrink;
+	allocator* alloc;
 } string;
 
 
 
 /*************************************************************************************************/
 
-/* 20 - 32 bytes. */
+/* Shares its first fields with 'vector'. Sorted unless 'frozen', see flat_map_freeze.
+ * 'key_type' is a RADIX_KEY_* if set by flat_map_set_key, 0 otherwise. 40 - 56 bytes. */
 typedef struct flat_map
 {
 	void* buckets;
 	sint bucket_size;
 	sint len;
 	sint cap;
+	sint shrink;
+	allocator* alloc;
 	cmpfunc cmp;
+	sint frozen;
+	sint key_offset;
+	sint key_type;
 } flat_map;
 
 
 
 /*************************************************************************************************/
 
-/* 28 - 48 bytes. */
+/* 'info' packs the low 24 hash bits and the probe distance of each slot. Setting 'incremental'
+ * spreads growing over the following pushes and pops instead of rehashing at once, 'migration'
+ * then holds the old table until it is drained. 'len' counts both tables. 44 - 72 bytes. */
 typedef struct flat_hashmap
 {
 	void* buckets;
-	u8* info;
+	u32* info;
 	sint bucket_size;
 	sint len;
 	sint cap;
+	sint shrink;
+	sint incremental;
+	allocator* alloc;
 	hashfunc hash;
 	cmpfunc cmp;
+	struct flat_hashmap_migration* migration;
 } flat_hashmap;
 
+/* Old table of an incremental resize, its slots are moved over in order starting at 'start'. */
+typedef struct flat_hashmap_migration
+{
+	flat_hashmap table;
+	sint start;
+	sint done;
+} flat_hashmap_migration;
+
+/* Each info word packs the low 24 bits of the hash above the 8-bit probe distance. */
+#define HASHMAP_INFO_EMPTY U32_MAX
+#define HASHMAP_INFO_DISTANCE(info) ((info) & 0xFF)
+#define HASHMAP_INFO_HASH(info) ((info) >> 8)
+#define HASHMAP_INFO_MAKE(hash, distance) ((((u32)(hash) & 0xFFFFFF) << 8) | (u32)(distance))
+
+
+
+/*************************************************************************************************/
+
+/* Control bytes hold a 7-bit hash tag for full slots and are probed 16 at a time.
+ * 'tombs' counts erased slots that still lengthen probe sequences. 40 - 64 bytes. */
+typedef struct flat_group_hashmap
+{
+	void* buckets;
+	s8* ctrl;
+	sint bucket_size;
+	sint len;
+	sint cap;
+	sint tombs;
+	sint shrink;
+	allocator* alloc;
+	hashfunc hash;
+	cmpfunc cmp;
+} flat_group_hashmap;
+
+
+
+/*************************************************************************************************/
+
+/* Linear probing on integer keys hashed inline, without 'info' words or function pointers. Slots
+ * holding 'empty' are free, so that key cannot be stored. 'values' is a parallel array of
+ * 'value_size' bytes, NULL for a set. Probes start at a group of INT_HASHMAP_GROUP slots and test
+ * the group at once. 32 - 48 bytes. */
+#define INT_HASHMAP_GROUP 4
+
+typedef struct int_hashmap
+{
+	u32* keys;
+	void* values;
+	sint value_size;
+	sint len;
+	sint cap;
+	sint shrink;
+	allocator* alloc;
+	u32 empty;
+} int_hashmap;
+
+#if defined(PLATFORM_HAS_I64)
+/* int_hashmap with u64 keys. 48 bytes. */
+typedef struct int64_hashmap
+{
+	u64* keys;
+	void* values;
+	sint value_size;
+	sint len;
+	sint cap;
+	sint shrink;
+	allocator* alloc;
+	u64 empty;
+} int64_hashmap;
+
+#endif /* I64 */
+
+/* Pointer keys go through (uptr), e.g. PTR_HASHMAP(get)(&map, (uptr)ptr). */
+#if UINTPTR_MAX > 0xFFFFFFFF
+typedef int64_hashmap ptr_hashmap;
+#define PTR_HASHMAP(func) int64_hashmap_##func
+
+#else
+typedef int_hashmap ptr_hashmap;
+#define PTR_HASHMAP(func) int_hashmap_##func
+
+#endif
+
 
 
 /*************************************************************************************************/
 
-/* 32 - 56 bytes. */
+/* 'dense' holds 'len' + 'tombs' buckets in insertion order, erased ones are marked in the 'dead'
+ * bitmap and dropped by the next compaction or resize. 'incremental' works as for flat_hashmap,
+ * but only the index is rebuilt incrementally, the dense array is copied at once. 56 - 96 bytes. */
 typedef struct flat_ordered_hashmap
 {
 	void* dense;
 	sint* sparse;
+	u32* dead;
 	u8* info;
 	sint bucket_size;
 	sint len;
 	sint cap;
+	sint tombs;
+	sint shrink;
+	sint incremental;
+	allocator* alloc;
 	sint(*hash)(void* a);
 	sint(*cmp)(void* a, void* b);
+	struct flat_ordered_hashmap_migration* migration;
 } flat_ordered_hashmap;
 
+/* Old index of an incremental resize. Dense entries below 'done' are in the new index already,
+ * 'memory' is the old allocation. */
+typedef struct flat_ordered_hashmap_migration
+{
+	void* memory;
+	sint* sparse;
+	u8* info;
+	sint cap;
+	sint len;
+	sint done;
+} flat_ordered_hashmap_migration;
+
+
+
+/*************************************************************************************************/
+
+#define CACHE_LRU 0
+#define CACHE_CLOCK 1
+
+typedef void(*evictfunc)(void* bucket, void* user);
+
+/* Bounded cache over the dense order of a flat_ordered_hashmap. LRU moves touched buckets to the
+ * back and evicts from the front, CLOCK sets a reference bit and 'hand' sweeps the dense order,
+ * clearing bits until it finds an unreferenced bucket. Each dense entry carries the bucket, its
+ * cost and reference bit at 'meta_offset'. 'max_len' and 'max_cost' are 0 for no limit. 'evict',
+ * called with 'user' for every bucket dropped to make room or on destroy, and the counters may
+ * be set by the caller. 108 - 176 bytes. */
+typedef struct cache
+{
+	flat_ordered_hashmap map;
+	void* scratch;
+	sint bucket_size;
+	sint meta_offset;
+	sint policy;
+	sint max_len;
+	uptr max_cost;
+	uptr cost;
+	sint hand;
+	evictfunc evict;
+	void* user;
+	uptr hits;
+	uptr misses;
+	uptr evictions;
+} cache;
+
 
 
 /*************************************************************************************************/
 
-/* The elem size should always be >= sizeof(uptr_t). 20 - 24 bytes. */
+/* The elem size should always be >= sizeof(uptr_t). Free elems are linked through their own
+ * storage, 'free' is the first free index or INVALID_INDEX. 32 - 40 bytes. */
 typedef struct pool
 {
 	void** data;
@@ -95,21 +270,140 @@ typedef struct pool
 	sint len;
 	sint cap;
 	sint bcap;
+	sint bshift;
+	sint free;
+	allocator* alloc;
 } pool;
 
 
 
+/*************************************************************************************************/
+
+#define SLOT_MAP_INDEX_BITS 20
+#define SLOT_MAP_INDEX_MASK ((1u << SLOT_MAP_INDEX_BITS) - 1)
+#define SLOT_MAP_MAX_COLUMNS 4
+
+/* Handles pack a 20 bit slot index and a 12 bit generation that is bumped on every erase, so
+ * stale handles stop resolving until the generation wraps. Generations start at 1, 0 is never a
+ * valid handle. Elements are packed in 'columns' for iteration, one vector per component in SoA
+ * mode. 'slots' holds the generation and dense index of every slot, or the next free slot.
+ * 'owners' maps dense indices back to their slot. 156 - 208 bytes. */
+typedef struct slot_map
+{
+	vector columns[SLOT_MAP_MAX_COLUMNS];
+	vector slots;
+	vector owners;
+	sint column_count;
+	sint len;
+	u32 free;
+} slot_map;
+
+
+
+/*************************************************************************************************/
+
+#if defined(PLATFORM_HAS_I64)
+typedef u64 bitset_word;
+
+#else
+typedef u32 bitset_word;
+
+#endif /* I64 */
+
+#define BITSET_WORD_BITS ((sint)sizeof(bitset_word) * 8)
+
+/* 'len' bits packed into 'cap' words, the bits past 'len' are always zero. 16 - 24 bytes. */
+typedef struct bitset
+{
+	bitset_word* words;
+	sint len;
+	sint cap;
+	allocator* alloc;
+} bitset;
+
+
+
+/*************************************************************************************************/
+
+typedef flt(*priorityfunc)(void* elem, void* user);
+
+/* Node of a priority_queue, 'slot' locates the elem. */
+typedef struct heap_node
+{
+	flt priority;
+	u32 slot;
+} heap_node;
+
+/* 4-ary implicit min-heap. 'nodes' holds heap_nodes in heap order while elems stay in their
+ * slot of 'elems', so sifting only moves nodes. 'positions' maps a slot to its node, free slots
+ * are linked through it starting at 'free'. Handles are slots. 64 - 104 bytes. */
+typedef struct priority_queue
+{
+	vector nodes;
+	vector elems;
+	vector positions;
+	sint free;
+} priority_queue;
+
+
+
+/*************************************************************************************************/
+
+#define SERIALIZED_MAGIC 0x54424C31 /* "TBL1" */
+#define SERIALIZED_ALIGN 64
+
+#define SERIALIZED_FLAT_MAP 1
+#define SERIALIZED_FLAT_HASHMAP 2
+
+/* Header of a serialized table, the offsets are relative to its start so the bytes can be mapped
+ * anywhere. Sections are SERIALIZED_ALIGN aligned. 36 bytes. */
+typedef struct serialized_table
+{
+	u32 magic;
+	u32 kind;
+	u32 bucket_size;
+	u32 len;
+	u32 cap;
+	u32 frozen;
+	u32 buckets;
+	u32 info;
+	u32 size;
+} serialized_table;
+
+/* Read-only tables over serialized bytes, e.g. a mapped file. The bytes have to outlive the view,
+ * only the *_view_* functions may be used on them. */
+typedef struct flat_map_view
+{
+	flat_map map;
+} flat_map_view;
+
+typedef struct flat_hashmap_view
+{
+	flat_hashmap map;
+} flat_hashmap_view;
+
+
+
 /*************************************************************************************************/
 
 sint get_container_capacity(sint len);
 
 
 
+/*************************************************************************************************/
+
+/* Every container has an *_init_alloc variant taking the allocator its memory comes from, the
+ * plain *_init uses malloc. The allocator has to outlive the container. */
+
+
+
 /*************************************************************************************************/
 
 /* 'size' is the size of a single elem in bytes. */
 vector vector_init(sint size, sint len);
 
+vector vector_init_alloc(sint size, sint len, allocator* alloc);
+
 void vector_destroy(vector* vec);
 
 void vector_reserve(vector* vec, sint len);
@@ -133,6 +427,8 @@ sint vector_find(vector* vec, void* elem, cmpfunc cmp);
 
 string string_init(sint len);
 
+string string_init_alloc(sint len, allocator* alloc);
+
 void string_destroy(string* str);
 
 void string_reserve(string* str, sint len);
@@ -160,6 +456,11 @@ sint string_cmp(string* a, string* b);
 
 sint string_hash(const char* string);
 
+#if defined(PLATFORM_HAS_I64)
+/* Length aware, see hash_bytes. */
+u64 string_hash_seeded(string* str, u64 seed);
+#endif
+
 sint utf8_symbol_size(const char c);
 
 sint utf8_len(const char* str);
@@ -195,6 +496,8 @@ sint utf32_len_utf8(const char* str);
 /* 'size' is the size of a single bucket in bytes. */
 flat_map flat_map_init(sint size, sint len, cmpfunc cmp);
 
+flat_map flat_map_init_alloc(sint size, sint len, cmpfunc cmp, allocator* alloc);
+
 void flat_map_destroy(flat_map* map);
 
 void flat_map_reserve(flat_map* map, sint len);
@@ -209,6 +512,44 @@ void* flat_map_push(flat_map* map, void* bucket);
 /* 'out_bucket' is used to store the data of a bucket if found. */
 sint flat_map_pop(flat_map* map, void* bucket, void* out_bucket);
 
+/* Reorder a read-mostly map into an Eytzinger layout for cache friendly lookups. flat_map_get
+ * searches the frozen layout, modifying functions thaw the map back into sorted order first. */
+void flat_map_freeze(flat_map* map);
+
+void flat_map_thaw(flat_map* map);
+
+/* flat_map_get on a frozen map. */
+void* flat_map_get_frozen(flat_map* map, void* bucket);
+
+/* Ordered iteration for both layouts, positions end with INVALID_INDEX.
+ * for (pos = flat_map_begin(map); pos != INVALID_INDEX; pos = flat_map_next(map, pos)) */
+sint flat_map_begin(flat_map* map);
+
+sint flat_map_next(flat_map* map, sint pos);
+
+void* flat_map_at(flat_map* map, sint pos);
+
+/* Declares that 'cmp' orders the buckets by the RADIX_KEY_* key at 'key_offset'. The bulk
+ * functions then sort with radix_sort and compare keys inline, sets of plain u32 keys use SIMD.
+ * Float keys are compared in the radix_sort order, -0 before 0 and NaNs by their bits. */
+void flat_map_set_key(flat_map* map, sint key_offset, sint key_type);
+
+/* Replaces the content with 'count' unsorted buckets, the first of equal buckets is kept. */
+void flat_map_build(flat_map* map, void* buckets, sint count);
+
+/* Merges 'count' buckets sorted by 'cmp' in linear time. Existing buckets win over equal ones in
+ * the batch, earlier ones over later ones. */
+void flat_map_push_sorted(flat_map* map, void* buckets, sint count);
+
+/* 'dst' is overwritten and must not be 'a' or 'b', equal buckets are taken from 'a'. The maps have
+ * to share bucket size and order, frozen ones are thawed. */
+void flat_map_union(flat_map* dst, flat_map* a, flat_map* b);
+
+void flat_map_intersection(flat_map* dst, flat_map* a, flat_map* b);
+
+/* The buckets of 'a' missing in 'b'. */
+void flat_map_difference(flat_map* dst, flat_map* a, flat_map* b);
+
 
 
 /*************************************************************************************************/
@@ -216,6 +557,8 @@ sint flat_map_pop(flat_map* map, void* bucket, void* out_bucket);
 /* 'size' is the size of a single bucket in bytes. */
 flat_hashmap flat_hashmap_init(sint size, sint len, hashfunc hash, cmpfunc cmp);
 
+flat_hashmap flat_hashmap_init_alloc(sint size, sint len, hashfunc hash, cmpfunc cmp, allocator* alloc);
+
 void flat_hashmap_destroy(flat_hashmap* map);
 
 void flat_hashmap_reserve(flat_hashmap* map, sint len);
@@ -230,6 +573,99 @@ void* flat_hashmap_push(flat_hashmap* map, void* bucket);
 /* 'out_bucket' is used to store the data of a bucket if found. */
 sint flat_hashmap_pop(flat_hashmap* map, void* bucket, void* out_bucket);
 
+/* Move up to 'slots' old slots of an incremental resize, e.g. to finish it while idle. */
+void flat_hashmap_migrate(flat_hashmap* map, sint slots);
+
+/* Building blocks for containers layered on flat_hashmap. 'hash' is the full hash of 'bucket'.
+ * flat_hashmap_insert expects the bucket not to be in the map and the map to have room. They
+ * only see the new table of an incremental resize. */
+void* flat_hashmap_get_index(flat_hashmap* map, sint hash, void* bucket, sint* out_index);
+
+void flat_hashmap_insert(flat_hashmap* map, sint hash, void* bucket);
+
+/* Remove the bucket at 'idx' without trimming. */
+void flat_hashmap_erase_index(flat_hashmap* map, sint idx);
+
+/* Insert every bucket of 'src' into 'dst', reusing the cached hash bits. */
+void flat_hashmap_rehash_into(flat_hashmap* dst, flat_hashmap* src);
+
+/* Look up 'count' consecutive buckets, overlapping their cache misses. 'out_buckets[i]' receives
+ * what flat_hashmap_get would return for the i-th bucket. The batch functions finish or bypass
+ * an incremental resize. */
+void flat_hashmap_get_many(flat_hashmap* map, void* buckets, sint count, void** out_buckets);
+
+/* Push 'count' consecutive buckets. 'out_buckets' may be NULL, otherwise 'out_buckets[i]'
+ * receives what flat_hashmap_push would return for the i-th bucket. */
+void flat_hashmap_push_many(flat_hashmap* map, void* buckets, sint count, void** out_buckets);
+
+
+
+/*************************************************************************************************/
+
+/* 'size' is the size of a single bucket in bytes. */
+flat_group_hashmap flat_group_hashmap_init(sint size, sint len, hashfunc hash, cmpfunc cmp);
+
+flat_group_hashmap flat_group_hashmap_init_alloc(sint size, sint len, hashfunc hash, cmpfunc cmp,
+	allocator* alloc);
+
+void flat_group_hashmap_destroy(flat_group_hashmap* map);
+
+void flat_group_hashmap_reserve(flat_group_hashmap* map, sint len);
+
+/* Trim array to lowest fitting capacity. */
+void flat_group_hashmap_trim(flat_group_hashmap* map);
+
+void* flat_group_hashmap_get(flat_group_hashmap* map, void* bucket);
+
+void* flat_group_hashmap_push(flat_group_hashmap* map, void* bucket);
+
+/* 'out_bucket' is used to store the data of a bucket if found. */
+sint flat_group_hashmap_pop(flat_group_hashmap* map, void* bucket, void* out_bucket);
+
+
+
+/*************************************************************************************************/
+
+/* 'value_size' is 0 for a set. */
+int_hashmap int_hashmap_init(sint value_size, sint len, u32 empty);
+
+int_hashmap int_hashmap_init_alloc(sint value_size, sint len, u32 empty, allocator* alloc);
+
+void int_hashmap_destroy(int_hashmap* map);
+
+void int_hashmap_reserve(int_hashmap* map, sint len);
+
+/* Trim array to lowest fitting capacity. */
+void int_hashmap_trim(int_hashmap* map);
+
+/* Returns the value of 'key', for a set the stored key, NULL if missing. */
+void* int_hashmap_get(int_hashmap* map, u32 key);
+
+/* Returns what int_hashmap_get returned before, 'value' is only copied in if the key is new. */
+void* int_hashmap_push(int_hashmap* map, u32 key, const void* value);
+
+/* 'out_value' may be NULL. */
+sint int_hashmap_pop(int_hashmap* map, u32 key, void* out_value);
+
+#if defined(PLATFORM_HAS_I64)
+int64_hashmap int64_hashmap_init(sint value_size, sint len, u64 empty);
+
+int64_hashmap int64_hashmap_init_alloc(sint value_size, sint len, u64 empty, allocator* alloc);
+
+void int64_hashmap_destroy(int64_hashmap* map);
+
+void int64_hashmap_reserve(int64_hashmap* map, sint len);
+
+void int64_hashmap_trim(int64_hashmap* map);
+
+void* int64_hashmap_get(int64_hashmap* map, u64 key);
+
+void* int64_hashmap_push(int64_hashmap* map, u64 key, const void* value);
+
+sint int64_hashmap_pop(int64_hashmap* map, u64 key, void* out_value);
+
+#endif /* I64 */
+
 
 
 /*************************************************************************************************/
@@ -237,6 +673,9 @@ sint flat_hashmap_pop(flat_hashmap* map, void* bucket, void* out_bucket);
 /* 'size' is the size of a single bucket in bytes. */
 flat_ordered_hashmap flat_ordered_hashmap_init(sint size, sint len, sint(*hash)(void* a), sint(*cmp)(void* a, void* b));
 
+flat_ordered_hashmap flat_ordered_hashmap_init_alloc(sint size, sint len, sint(*hash)(void* a),
+	sint(*cmp)(void* a, void* b), allocator* alloc);
+
 void flat_ordered_hashmap_destroy(flat_ordered_hashmap* map);
 
 void flat_ordered_hashmap_reserve(flat_ordered_hashmap* map, sint len);
@@ -248,29 +687,245 @@ void* flat_ordered_hashmap_get(flat_ordered_hashmap* map, void* bucket);
 
 void* flat_ordered_hashmap_push(flat_ordered_hashmap* map, void* bucket);
 
-/* 'out_bucket' is used to store the data of a bucket if found. */
+/* 'out_bucket' is used to store the data of a bucket if found. The bucket is left behind as a
+ * tombstone, the dense array is compacted once tombstones outnumber the live buckets. */
 sint flat_ordered_hashmap_pop(flat_ordered_hashmap* map, void* bucket, void* out_bucket);
 
+/* Drops all tombstones, afterwards the first 'len' dense buckets are the live ones. */
+void flat_ordered_hashmap_compact(flat_ordered_hashmap* map);
+
+/* Insertion order iteration skipping tombstones, positions end with INVALID_INDEX.
+ * for (pos = flat_ordered_hashmap_begin(map); pos != INVALID_INDEX; pos = flat_ordered_hashmap_next(map, pos)) */
+sint flat_ordered_hashmap_begin(flat_ordered_hashmap* map);
+
+sint flat_ordered_hashmap_next(flat_ordered_hashmap* map, sint pos);
+
+void* flat_ordered_hashmap_at(flat_ordered_hashmap* map, sint pos);
+
+/* Index up to 'count' entries of an incremental resize. */
+void flat_ordered_hashmap_migrate(flat_ordered_hashmap* map, sint count);
+
+/* See flat_hashmap_get_many. */
+void flat_ordered_hashmap_get_many(flat_ordered_hashmap* map, void* buckets, sint count, void** out_buckets);
+
+/* See flat_hashmap_push_many. */
+void flat_ordered_hashmap_push_many(flat_ordered_hashmap* map, void* buckets, sint count, void** out_buckets);
+
+
+
+/*************************************************************************************************/
+
+/* 'size' is the size of a single bucket in bytes, 'policy' is CACHE_LRU or CACHE_CLOCK. */
+cache cache_init(sint size, sint max_len, uptr max_cost, sint policy, hashfunc hash, cmpfunc cmp);
+
+cache cache_init_alloc(sint size, sint max_len, uptr max_cost, sint policy, hashfunc hash, cmpfunc cmp,
+	allocator* alloc);
+
+/* Evicts every bucket. */
+void cache_destroy(cache* cache);
+
+/* Counts a hit or miss and touches the bucket if found. The result is valid until the next call
+ * on the cache, LRU moves the bucket. */
+void* cache_get(cache* cache, void* bucket);
+
+/* Returns the cached bucket as cache_get would, without counting it. Otherwise evicts until
+ * the bucket fits, inserts it with 'cost' and returns NULL. */
+void* cache_put(cache* cache, void* bucket, uptr cost);
+
+/* Marks the bucket as used without counting, returns INVALID_INDEX if it is not cached. */
+sint cache_touch(cache* cache, void* bucket);
+
+/* Removes the bucket without calling 'evict', 'out_bucket' is used to store its data. 'bucket'
+ * may be a result of cache_get. */
+sint cache_pop(cache* cache, void* bucket, void* out_bucket);
+
 
 
 /*************************************************************************************************/
 
 /* 'size' is the size of a single elem in bytes.
- * 'bcap' is the number of elements a single block/allocation can hold. */
+ * 'bcap' is the number of elements a single block/allocation can hold, rounded up to a power of
+ * two. Blocks are never moved, so elem addresses stay valid until the elem is erased. */
 pool pool_init(sint size, sint len, sint bcap);
 
+pool pool_init_alloc(sint size, sint len, sint bcap, allocator* alloc);
+
 void pool_destroy(pool* pool);
 
-/* 'size' is the size of a single elem in bytes. */
+/* Allocate blocks until 'len' elems fit. */
 void pool_reserve(pool* pool, sint len);
 
-/* 'size' is the size of a single elem in bytes. */
 void* pool_get(pool* pool, sint idx);
 
-/* 'size' is the size of a single elem in bytes. */
+/* Returns the index of the elem, freed indices are reused first. */
 u32 pool_push(pool* pool, void* elem);
 
-/* 'size' is the size of a single elem in bytes. */
+/* Erasing an index that is not in use corrupts the free list. */
 void pool_erase(pool* pool, sint idx);
 
 
+
+/*************************************************************************************************/
+
+/* 'size' is the size of a single elem in bytes. */
+slot_map slot_map_init(sint size, sint len);
+
+slot_map slot_map_init_alloc(sint size, sint len, allocator* alloc);
+
+/* SoA mode, 'sizes' holds the elem size of each of the 'count' columns. */
+slot_map slot_map_init_columns(sint* sizes, sint count, sint len, allocator* alloc);
+
+void slot_map_destroy(slot_map* map);
+
+void slot_map_reserve(slot_map* map, sint len);
+
+/* Trims the columns, slots are kept since handles refer to them. */
+void slot_map_trim(slot_map* map);
+
+/* Returns the handle of the new elem. 'elem' is copied to the first column, the other columns are
+ * zeroed and filled through slot_map_get_column. */
+u32 slot_map_push(slot_map* map, void* elem);
+
+/* Returns the dense index of a handle or INVALID_INDEX if it is stale. */
+sint slot_map_find(slot_map* map, u32 handle);
+
+void* slot_map_get(slot_map* map, u32 handle);
+
+void* slot_map_get_column(slot_map* map, u32 handle, sint column);
+
+/* The last elem is moved into the gap, so dense indices are not stable. */
+sint slot_map_erase(slot_map* map, u32 handle);
+
+/* Handle of the elem at dense index 'idx', for iterating the columns directly. */
+u32 slot_map_handle(slot_map* map, sint idx);
+
+
+
+/*************************************************************************************************/
+
+/* All 'len' bits start cleared. */
+bitset bitset_init(sint len);
+
+bitset bitset_init_alloc(sint len, allocator* alloc);
+
+void bitset_destroy(bitset* set);
+
+/* Added bits are cleared. */
+void bitset_resize(bitset* set, sint len);
+
+sint bitset_get(bitset* set, sint idx);
+
+void bitset_set(bitset* set, sint idx);
+
+void bitset_clear(bitset* set, sint idx);
+
+/* Sets all bits if 'value' is non-zero, clears them otherwise. */
+void bitset_fill(bitset* set, sint value);
+
+/* 'dst' = 'dst' op 'src', bits past the end of 'src' count as zero. */
+void bitset_and(bitset* dst, bitset* src);
+
+void bitset_or(bitset* dst, bitset* src);
+
+/* 'dst' = 'dst' & ~'src'. */
+void bitset_andnot(bitset* dst, bitset* src);
+
+/* Number of set bits. */
+sint bitset_count(bitset* set);
+
+/* First set bit at or after 'idx', or INVALID_INDEX.
+ * for (i = bitset_next(set, 0); i != INVALID_INDEX; i = bitset_next(set, i + 1)) */
+sint bitset_next(bitset* set, sint idx);
+
+/* First cleared bit at or after 'idx', or INVALID_INDEX if all are set. */
+sint bitset_next_zero(bitset* set, sint idx);
+
+
+
+/*************************************************************************************************/
+
+/* 'size' is the size of a single elem in bytes. */
+priority_queue priority_queue_init(sint size, sint len);
+
+priority_queue priority_queue_init_alloc(sint size, sint len, allocator* alloc);
+
+void priority_queue_destroy(priority_queue* queue);
+
+void priority_queue_reserve(priority_queue* queue, sint len);
+
+/* Returns the handle of the elem, valid until it leaves the queue. */
+sint priority_queue_push(priority_queue* queue, void* elem, flt priority);
+
+/* Pushes 'count' consecutive elems, large batches are heapified at once. 'out_handles' may be
+ * NULL. */
+void priority_queue_push_many(priority_queue* queue, void* elems, flt* priorities, sint count,
+	sint* out_handles);
+
+/* Handle of the elem with the lowest priority, INVALID_INDEX if the queue is empty. */
+sint priority_queue_top(priority_queue* queue);
+
+void* priority_queue_get(priority_queue* queue, sint handle);
+
+flt priority_queue_priority(priority_queue* queue, sint handle);
+
+/* 'out_elem' is used to store the data of the popped elem if not NULL. */
+sint priority_queue_pop(priority_queue* queue, void* out_elem);
+
+void priority_queue_update_priority(priority_queue* queue, sint handle, flt priority);
+
+/* 'out_elem' is used to store the data of the elem if not NULL. */
+void priority_queue_remove(priority_queue* queue, sint handle, void* out_elem);
+
+/* Recomputes every priority through 'func' and rebuilds the heap in linear time, cheaper than
+ * updating most of the elems one by one. */
+void priority_queue_reprioritize(priority_queue* queue, priorityfunc func, void* user);
+
+
+
+/*************************************************************************************************/
+
+#define RADIX_KEY_U32 1
+#define RADIX_KEY_U64 2
+#define RADIX_KEY_F32 3
+
+/* Calls 'task(data, idx)' for every idx below 'count', possibly in parallel, and returns once all
+ * calls are done. */
+typedef void(*dispatchfunc)(void(*task)(void* data, sint idx), void* data, sint count);
+
+/* Stable LSD radix sort of 'len' elems of 'size' bytes by the key at 'key_offset', one key byte
+ * per pass. Passes in which all keys share the byte are skipped. Float keys sort negatives first,
+ * NaNs by their bits. Temporary memory comes from 'scratch', e.g. a frame arena, NULL uses malloc. */
+void radix_sort(void* elems, sint size, sint len, sint key_offset, sint key_type, allocator* scratch);
+
+/* Splits every pass into 'tasks' chunks that are counted and scattered through 'dispatch'. */
+void radix_sort_parallel(void* elems, sint size, sint len, sint key_offset, sint key_type,
+	allocator* scratch, sint tasks, dispatchfunc dispatch);
+
+/* Writes the permutation that sorts the elems to 'out_indices', the elems are not moved. */
+void radix_sort_indices(void* elems, sint size, sint len, sint key_offset, sint key_type,
+	u32* out_indices, allocator* scratch);
+
+void vector_radix_sort(vector* vec, sint key_offset, sint key_type, allocator* scratch);
+
+
+
+/*************************************************************************************************/
+
+/* Buckets are copied as they are, so they must not contain pointers, e.g. store names as offsets
+ * into a string blob appended by the caller. 'out' needs SERIALIZED_ALIGN alignment, NULL only
+ * returns the size in bytes. A frozen flat_map keeps its layout. */
+uptr flat_map_serialize(flat_map* map, void* out);
+
+/* Finishes a running incremental resize first. The view has to use the same hash function. */
+uptr flat_hashmap_serialize(flat_hashmap* map, void* out);
+
+/* No parsing or allocation, 'data' is only checked. Returns INVALID_INDEX if it is not a table of
+ * 'bucket_size' buckets, is misaligned, or its header does not fit the sections within 'size'. */
+sint flat_map_view_init(flat_map_view* view, const void* data, uptr size, sint bucket_size, cmpfunc cmp);
+
+sint flat_hashmap_view_init(flat_hashmap_view* view, const void* data, uptr size, sint bucket_size,
+	hashfunc hash, cmpfunc cmp);
+
+const void* flat_map_view_get(flat_map_view* view, void* bucket);
+
+const void* flat_hashmap_view_get(flat_hashmap_view* view, void* bucket);
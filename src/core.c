@@ -101,6 +101,63 @@ sint ctz(uint val)
 #endif
 }
 
+sint popcount(uint val)
+{
+#if defined(COMPILER_GCC) || defined(COMPILER_CLANG)
+	return __builtin_popcount(val);
+
+#else
+	/* __popcnt on MSVC needs the POPCNT instruction, so stay portable. */
+	val = val - ((val >> 1) & 0x55555555);
+	val = (val & 0x33333333) + ((val >> 2) & 0x33333333);
+	val = (val + (val >> 4)) & 0x0F0F0F0F;
+	return (sint)((val * 0x01010101) >> 24);
+#endif
+}
+
+#if defined(PLATFORM_HAS_I64)
+sint clz64(u64 val)
+{
+#if defined(COMPILER_MSVC)
+	unsigned long index;
+	_BitScanReverse64(&index, val);
+	return 63 - index;
+
+#elif defined(COMPILER_GCC) || defined(COMPILER_CLANG)
+	return __builtin_clzll(val);
+
+#else
+	return (val >> 32) != 0 ? clz((uint)(val >> 32)) : 32 + clz((uint)val);
+#endif
+}
+
+sint ctz64(u64 val)
+{
+#if defined(COMPILER_MSVC)
+	unsigned long index;
+	_BitScanForward64(&index, val);
+	return index;
+
+#elif defined(COMPILER_GCC) || defined(COMPILER_CLANG)
+	return __builtin_ctzll(val);
+
+#else
+	return (uint)val != 0 ? ctz((uint)val) : 32 + ctz((uint)(val >> 32));
+#endif
+}
+
+sint popcount64(u64 val)
+{
+#if defined(COMPILER_GCC) || defined(COMPILER_CLANG)
+	return __builtin_popcountll(val);
+
+#else
+	return popcount((uint)val) + popcount((uint)(val >> 32));
+#endif
+}
+
+#endif /* I64 */
+
 
 
 /**************************************************************************************************/
@@ -97,11 +97,16 @@
 #define PLATFORM_HAS_F64 1
 #define CACHE_LINE 64
 
+#if defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PLATFORM_HAS_SSE2 1
+#endif
+
 #endif /* X86 */
 
 #if defined(PLATFORM_X64)
 #define PLATFORM_HAS_I64 1
 #define PLATFORM_HAS_F64 1
+#define PLATFORM_HAS_SSE2 1
 #define CACHE_LINE 64
 
 #endif /* X64 */
@@ -113,6 +118,7 @@
 
 #if defined(PLATFORM_ARM64)
 #define PLATFORM_HAS_I64 1
+#define PLATFORM_HAS_NEON 1
 #define CACHE_LINE 64
 
 #endif /* ARM64 */
@@ -136,6 +142,13 @@
 #define alignas(alignment) __declspec(align(alignment))
 #define alignof(T) __alignof(T)
 
+#include <intrin.h>
+#if defined(PLATFORM_X64) || defined(PLATFORM_X86)
+#define prefetch(addr) _mm_prefetch((const char*)(addr), _MM_HINT_T0)
+#else
+#define prefetch(addr) __prefetch(addr)
+#endif
+
 #endif /* MSVC */
 
 #if defined(COMPILER_GCC) /* GCC */
@@ -147,6 +160,8 @@
 #define alignas(alignment) __attribute__ ((aligned (alignment)))
 #define alignof(T) __alignof__(T)
 
+#define prefetch(addr) __builtin_prefetch(addr)
+
 #endif /* GCC */
 
 #if defined(COMPILER_CLANG) /* CLANG */
@@ -158,12 +173,102 @@
 #define alignas(alignment) __attribute__ ((aligned (alignment)))
 #define alignof(T) __alignof__(T)
 
+#define prefetch(addr) __builtin_prefetch(addr)
+
 #endif /* CLANG */
 
 #define cachealign alignas(CACHE_LINE)
 
 
 
+/**************************************************************************************************/
+/*	Atomics  */
+
+/* Loads acquire, stores release, read-modify-writes are full barriers and return the previous
+ * value. The 32-bit variants operate on u32, the ptr variants on void*. */
+
+#if defined(COMPILER_MSVC) /* MSVC */
+
+/* Loads must not write, readers would contend for the cache line. */
+#if defined(PLATFORM_X64) || defined(PLATFORM_X86)
+static forceinline unsigned int atomic_load_acquire32(const volatile void* ptr)
+{
+	unsigned int val = (unsigned int)__iso_volatile_load32((const volatile __int32*)ptr);
+	_ReadWriteBarrier();
+	return val;
+}
+
+static forceinline void* atomic_load_acquire_ptr(const volatile void* ptr)
+{
+	void* val = *(void* const volatile*)ptr;
+	_ReadWriteBarrier();
+	return val;
+}
+
+#else
+static forceinline unsigned int atomic_load_acquire32(const volatile void* ptr)
+{
+	return (unsigned int)__ldar32((volatile unsigned __int32*)ptr);
+}
+
+static forceinline void* atomic_load_acquire_ptr(const volatile void* ptr)
+{
+	return (void*)__ldar64((volatile unsigned __int64*)ptr);
+}
+
+#endif
+
+#define atomic_load32(ptr) ((u32)atomic_load_acquire32(ptr))
+#define atomic_store32(ptr, val) ((void)_InterlockedExchange((volatile long*)(ptr), (long)(val)))
+#define atomic_add32(ptr, val) ((u32)_InterlockedExchangeAdd((volatile long*)(ptr), (long)(val)))
+#define atomic_cas32(ptr, expected, desired) \
+	((u32)_InterlockedCompareExchange((volatile long*)(ptr), (long)(desired), (long)(expected)))
+
+#define atomic_load_ptr(ptr) atomic_load_acquire_ptr(ptr)
+#define atomic_store_ptr(ptr, val) ((void)_InterlockedExchangePointer((void* volatile*)(ptr), (val)))
+#define atomic_cas_ptr(ptr, expected, desired) \
+	_InterlockedCompareExchangePointer((void* volatile*)(ptr), (desired), (expected))
+
+#if defined(PLATFORM_X64) || defined(PLATFORM_X86)
+#define atomic_fence() _mm_mfence()
+#define atomic_fence_acquire() _ReadWriteBarrier()
+#define atomic_fence_release() _ReadWriteBarrier()
+#define cpu_pause() _mm_pause()
+#else
+#define atomic_fence() __dmb(_ARM64_BARRIER_ISH)
+#define atomic_fence_acquire() __dmb(_ARM64_BARRIER_ISHLD)
+#define atomic_fence_release() __dmb(_ARM64_BARRIER_ISH)
+#define cpu_pause() __yield()
+#endif
+
+#endif /* MSVC */
+
+#if defined(COMPILER_GCC) || defined(COMPILER_CLANG) /* GCC, CLANG */
+#define atomic_load32(ptr) __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+#define atomic_store32(ptr, val) __atomic_store_n((ptr), (val), __ATOMIC_RELEASE)
+#define atomic_add32(ptr, val) __atomic_fetch_add((ptr), (val), __ATOMIC_SEQ_CST)
+#define atomic_cas32(ptr, expected, desired) __sync_val_compare_and_swap((ptr), (expected), (desired))
+
+#define atomic_load_ptr(ptr) __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+#define atomic_store_ptr(ptr, val) __atomic_store_n((ptr), (val), __ATOMIC_RELEASE)
+#define atomic_cas_ptr(ptr, expected, desired) __sync_val_compare_and_swap((ptr), (expected), (desired))
+
+#define atomic_fence() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#define atomic_fence_acquire() __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#define atomic_fence_release() __atomic_thread_fence(__ATOMIC_RELEASE)
+
+#if defined(PLATFORM_X64) || defined(PLATFORM_X86)
+#define cpu_pause() __builtin_ia32_pause()
+#elif defined(PLATFORM_ARM64) || defined(PLATFORM_ARM32)
+#define cpu_pause() __asm__ __volatile__("yield")
+#else
+#define cpu_pause()
+#endif
+
+#endif /* GCC, CLANG */
+
+
+
 /**************************************************************************************************/
 /*	Types  */
 
@@ -243,5 +348,13 @@ void throw_exception(const char* format, ...);
 
 sint clz(uint val);
 sint ctz(uint val);
+sint popcount(uint val);
+
+#if defined(PLATFORM_HAS_I64)
+sint clz64(u64 val);
+sint ctz64(u64 val);
+sint popcount64(u64 val);
+
+#endif /* I64 */
 
 
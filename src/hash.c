@@ -0,0 +1,288 @@
+#include "hash.h"
+
+#if defined(PLATFORM_HAS_SSE2)
+#include <emmintrin.h>
+#elif defined(PLATFORM_HAS_NEON)
+#include <arm_neon.h>
+#endif
+
+
+
+#if defined(PLATFORM_HAS_I64)
+
+/**************************************************************************************************/
+
+#define HASH_P0 0xA0761D6478BD642Full
+#define HASH_P1 0xE7037ED1A0B428DBull
+#define HASH_P2 0x8EBC6AF09C88C6E3ull
+#define HASH_P3 0x589965CC75374CC3ull
+#define HASH_P32 0x9E3779B1u
+
+/* Stripes between two scrambles of the accumulators. */
+#define HASH_BLOCK_STRIPES 16
+
+/* All reads are little endian, which every supported platform is. */
+static u64 hash_read64(const u8* p)
+{
+	u64 v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static u64 hash_read32(const u8* p)
+{
+	u32 v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+/* 1 - 3 bytes. */
+static u64 hash_read3(const u8* p, uptr len)
+{
+	return ((u64)p[0] << 16) | ((u64)p[len >> 1] << 8) | p[len - 1];
+}
+
+/* 64x64 -> 128 bit multiply, the low half is written to 'a', the high half to 'b'. */
+static void hash_mul128(u64* a, u64* b)
+{
+#if defined(COMPILER_MSVC) && defined(PLATFORM_X64)
+	*a = _umul128(*a, *b, b);
+
+#elif defined(COMPILER_MSVC) && defined(PLATFORM_ARM64)
+	u64 lo = *a * *b;
+	*b = __umulh(*a, *b);
+	*a = lo;
+
+#elif (defined(COMPILER_GCC) || defined(COMPILER_CLANG)) && defined(__SIZEOF_INT128__)
+	__uint128_t r = (__uint128_t)*a * *b;
+	*a = (u64)r;
+	*b = (u64)(r >> 64);
+
+#else
+	u64 ha = *a >> 32, hb = *b >> 32, la = (u32)*a, lb = (u32)*b;
+	u64 rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+	u64 t = rl + (rm0 << 32), c = t < rl, lo;
+
+	lo = t + (rm1 << 32);
+	c += lo < t;
+	*a = lo;
+	*b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+
+#endif
+}
+
+static u64 hash_mix(u64 a, u64 b)
+{
+	hash_mul128(&a, &b);
+	return a ^ b;
+}
+
+
+
+/**************************************************************************************************/
+/*	Stripes  */
+
+/* Each 64-bit lane multiplies the low and high half of (data ^ key) and adds the data of its
+ * neighbour lane, so no input bits are lost in the 32x32 bit products. The lane keys advance by
+ * a constant every stripe. */
+static void hash_accumulate(u64* acc, const u8* p, uptr stripes, u64* keys)
+{
+	uptr s;
+
+#if defined(PLATFORM_HAS_SSE2)
+	__m128i a0 = _mm_loadu_si128((const __m128i*)acc);
+	__m128i a1 = _mm_loadu_si128((const __m128i*)(acc + 2));
+	__m128i k0 = _mm_loadu_si128((const __m128i*)keys);
+	__m128i k1 = _mm_loadu_si128((const __m128i*)(keys + 2));
+	__m128i step = _mm_set1_epi64x((long long)HASH_P3);
+
+	for (s = 0; s < stripes; s++, p += 32)
+	{
+		__m128i d0 = _mm_loadu_si128((const __m128i*)p);
+		__m128i d1 = _mm_loadu_si128((const __m128i*)(p + 16));
+		__m128i x0 = _mm_xor_si128(d0, k0);
+		__m128i x1 = _mm_xor_si128(d1, k1);
+
+		a0 = _mm_add_epi64(a0, _mm_mul_epu32(x0, _mm_srli_epi64(x0, 32)));
+		a1 = _mm_add_epi64(a1, _mm_mul_epu32(x1, _mm_srli_epi64(x1, 32)));
+		a0 = _mm_add_epi64(a0, _mm_shuffle_epi32(d0, _MM_SHUFFLE(1, 0, 3, 2)));
+		a1 = _mm_add_epi64(a1, _mm_shuffle_epi32(d1, _MM_SHUFFLE(1, 0, 3, 2)));
+		k0 = _mm_add_epi64(k0, step);
+		k1 = _mm_add_epi64(k1, step);
+	}
+
+	_mm_storeu_si128((__m128i*)acc, a0);
+	_mm_storeu_si128((__m128i*)(acc + 2), a1);
+	_mm_storeu_si128((__m128i*)keys, k0);
+	_mm_storeu_si128((__m128i*)(keys + 2), k1);
+
+#elif defined(PLATFORM_HAS_NEON)
+	uint64x2_t a0 = vld1q_u64(acc);
+	uint64x2_t a1 = vld1q_u64(acc + 2);
+	uint64x2_t k0 = vld1q_u64(keys);
+	uint64x2_t k1 = vld1q_u64(keys + 2);
+	uint64x2_t step = vdupq_n_u64(HASH_P3);
+
+	for (s = 0; s < stripes; s++, p += 32)
+	{
+		uint64x2_t d0 = vreinterpretq_u64_u8(vld1q_u8(p));
+		uint64x2_t d1 = vreinterpretq_u64_u8(vld1q_u8(p + 16));
+		uint64x2_t x0 = veorq_u64(d0, k0);
+		uint64x2_t x1 = veorq_u64(d1, k1);
+
+		a0 = vmlal_u32(a0, vmovn_u64(x0), vshrn_n_u64(x0, 32));
+		a1 = vmlal_u32(a1, vmovn_u64(x1), vshrn_n_u64(x1, 32));
+		a0 = vaddq_u64(a0, vextq_u64(d0, d0, 1));
+		a1 = vaddq_u64(a1, vextq_u64(d1, d1, 1));
+		k0 = vaddq_u64(k0, step);
+		k1 = vaddq_u64(k1, step);
+	}
+
+	vst1q_u64(acc, a0);
+	vst1q_u64(acc + 2, a1);
+	vst1q_u64(keys, k0);
+	vst1q_u64(keys + 2, k1);
+
+#else
+	sint i;
+
+	for (s = 0; s < stripes; s++, p += 32)
+	{
+		for (i = 0; i < 4; i++)
+		{
+			u64 d = hash_read64(p + i * 8);
+			u64 x = d ^ keys[i];
+
+			acc[i] += (x & 0xFFFFFFFF) * (x >> 32);
+			acc[i ^ 1] += d;
+		}
+
+		for (i = 0; i < 4; i++)
+			keys[i] += HASH_P3;
+	}
+
+#endif
+}
+
+static void hash_scramble(u64* acc, u64 seed)
+{
+	sint i;
+
+	for (i = 0; i < 4; i++)
+	{
+		acc[i] ^= acc[i] >> 47;
+		acc[i] ^= seed;
+		acc[i] *= HASH_P32;
+	}
+}
+
+static u64 hash_stripes(const u8* p, uptr len, u64 seed)
+{
+	u64 acc[4], keys[4];
+	uptr block, stripes;
+	u64 h;
+
+	acc[0] = seed ^ HASH_P0;
+	acc[1] = seed ^ HASH_P1;
+	acc[2] = seed ^ HASH_P2;
+	acc[3] = seed ^ HASH_P3;
+	keys[0] = seed + HASH_P1;
+	keys[1] = seed - HASH_P2;
+	keys[2] = seed ^ HASH_P3;
+	keys[3] = ~seed;
+
+	block = (uptr)HASH_BLOCK_STRIPES * 32;
+
+	for (; len > block; p += block, len -= block)
+	{
+		hash_accumulate(acc, p, HASH_BLOCK_STRIPES, keys);
+		hash_scramble(acc, seed);
+	}
+
+	/* The remaining 1 - 16 stripes, the last one overlaps the one before. */
+	stripes = (len - 1) / 32;
+	hash_accumulate(acc, p, stripes, keys);
+	hash_accumulate(acc, p + len - 32, 1, keys);
+
+	h = len * HASH_P0;
+	h += hash_mix(acc[0] ^ HASH_P1, acc[1] ^ HASH_P2);
+	h += hash_mix(acc[2] ^ HASH_P3, acc[3] ^ HASH_P0);
+	return hash_mix(h ^ seed, HASH_P1);
+}
+
+
+
+/**************************************************************************************************/
+
+u64 hash_bytes(const void* data, uptr len, u64 seed)
+{
+	const u8* p = (const u8*)data;
+	u64 a, b;
+
+	seed ^= hash_mix(seed ^ HASH_P0, HASH_P1);
+
+	if (len <= 16)
+	{
+		if (len >= 4)
+		{
+			uptr mid = (len >> 3) << 2;
+
+			a = (hash_read32(p) << 32) | hash_read32(p + mid);
+			b = (hash_read32(p + len - 4) << 32) | hash_read32(p + len - 4 - mid);
+		}
+		else if (len > 0)
+		{
+			a = hash_read3(p, len);
+			b = 0;
+		}
+		else
+		{
+			a = b = 0;
+		}
+	}
+	else if (len > HASH_STRIPE_MIN)
+	{
+		return hash_stripes(p, len, seed);
+	}
+	else
+	{
+		uptr i = len;
+
+		if (i > 32)
+		{
+			u64 s1 = seed;
+
+			for (; i > 32; i -= 32, p += 32)
+			{
+				seed = hash_mix(hash_read64(p) ^ HASH_P1, hash_read64(p + 8) ^ seed);
+				s1 = hash_mix(hash_read64(p + 16) ^ HASH_P2, hash_read64(p + 24) ^ s1);
+			}
+
+			seed ^= s1;
+		}
+
+		for (; i > 16; i -= 16, p += 16)
+			seed = hash_mix(hash_read64(p) ^ HASH_P1, hash_read64(p + 8) ^ seed);
+
+		/* The last 16 bytes, overlapping what was already consumed. */
+		a = hash_read64(p + i - 16);
+		b = hash_read64(p + i - 8);
+	}
+
+	a ^= HASH_P1;
+	b ^= seed;
+	hash_mul128(&a, &b);
+	return hash_mix(a ^ HASH_P0 ^ len, b ^ HASH_P1);
+}
+
+u64 hash_cstr(const char* str, u64 seed)
+{
+	return hash_bytes(str, strlen(str), seed);
+}
+
+u64 hash_make_seed(const void* salt)
+{
+	return hash_mix((u64)(uptr)salt ^ HASH_P2, (u64)clock() ^ (u64)time(NULL) ^ HASH_P3);
+}
+
+#endif /* I64 */
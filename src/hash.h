@@ -0,0 +1,70 @@
+#pragma once
+
+
+
+#include "core.h"
+
+
+
+/**************************************************************************************************/
+/*	Integer Hashes  */
+
+static inline sint hash_u32(u32 key)
+{
+	key ^= key >> 16;
+	key *= 0x7FEB352Du;
+	key ^= key >> 15;
+	key *= 0x846CA68Bu;
+	key ^= key >> 16;
+	return (sint)key;
+}
+
+#if defined(PLATFORM_HAS_I64)
+static inline sint hash_u64(u64 key)
+{
+	key ^= key >> 33;
+	key *= 0xFF51AFD7ED558CCDull;
+	key ^= key >> 33;
+	key *= 0xC4CEB9FE1A85EC53ull;
+	key ^= key >> 33;
+	return (sint)key;
+}
+
+static inline sint hash_ptr(const void* key)
+{
+	return hash_u64((u64)(uptr)key);
+}
+
+#else
+static inline sint hash_ptr(const void* key)
+{
+	return hash_u32((u32)(uptr)key);
+}
+
+#endif /* I64 */
+
+
+
+/**************************************************************************************************/
+/*	Byte Hashes
+ *
+ *	Seeded 64-bit hash over byte ranges. Short inputs are folded with 64x64->128 bit multiplies,
+ *	16 - 32 bytes per step. Inputs above HASH_STRIPE_MIN bytes are accumulated in four 64-bit lanes
+ *	32 bytes at a time, using SSE2 or NEON where available. Every path returns the same value on
+ *	every platform, so hashes can be stored. Tables should use their own seed so that collisions
+ *	found for one table do not carry over to others. */
+
+#if defined(PLATFORM_HAS_I64)
+
+#define HASH_STRIPE_MIN 256
+
+/* Hash 'len' bytes at 'data'. */
+u64 hash_bytes(const void* data, uptr len, u64 seed);
+
+/* Hash a null-terminated string. */
+u64 hash_cstr(const char* str, u64 seed);
+
+/* Hash a seed for a new table from an address and the clock. */
+u64 hash_make_seed(const void* salt);
+
+#endif /* I64 */
@@ -151,6 +151,45 @@ void* load_file(const char* path, size_t* out_size)
     return buffer;
 }
 
+void* map_file(const char* path, size_t* out_size)
+{
+    HANDLE file, mapping;
+    LARGE_INTEGER file_size;
+    void* data;
+
+    file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+    if (file == INVALID_HANDLE_VALUE)
+        return NULL;
+
+    /* Empty files cannot be mapped. */
+    if (!GetFileSizeEx(file, &file_size) || (file_size.QuadPart == 0))
+    {
+        CloseHandle(file);
+        return NULL;
+    }
+
+    /* The view keeps the mapping alive, both handles can be closed right away. */
+    mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+
+    if (mapping == NULL)
+        return NULL;
+
+    data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+
+    if ((data != NULL) && (out_size != NULL))
+        *out_size = (size_t)file_size.QuadPart;
+
+    return data;
+}
+
+void unmap_file(void* data)
+{
+    UnmapViewOfFile(data);
+}
+
 sint create_dir(const char* path)
 {
     return -1;
@@ -32,6 +32,9 @@ sint is_dir(const char* path);
 /*	File  */
 
 void* load_file(const char* path, size_t* out_size);
+/*  Maps a file read-only, page aligned. Release it with unmap_file!  */
+void* map_file(const char* path, size_t* out_size);
+void unmap_file(void* data);
 sint create_dir(const char* path);
 sint remove_dir(const char* path);
 char** list_dir(const char* path);
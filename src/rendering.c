@@ -106,6 +106,10 @@ typedef struct vk_mesh {
 static VkInstance instance = VK_NULL_HANDLE;
 static u32 frame_idx = 0;
 
+/*	Per Frame, reset once the frame's fence has signaled  */
+static arena frame_arenas[MAX_PARALLEL_FRAMES];
+static allocator frame_allocators[MAX_PARALLEL_FRAMES];
+
 /*	Per GPU  */
 static vk_device device;
 
@@ -179,17 +183,14 @@ static sint check_device_extension_support(VkPhysicalDevice gpu)
 {
 	VkExtensionProperties* extensions;
 	u32 num, i, j, supported_count = 0;
+	arena_marker marker = arena_mark(frame_arenas + frame_idx);
 	
 	const char* required[] = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
 	u32 required_count = 1;
 
 
 	vkEnumerateDeviceExtensionProperties(gpu, NULL, &num, NULL);
-	extensions = calloc(num, sizeof(VkExtensionProperties));
-
-	if (extensions == NULL)
-		return 0;
-
+	extensions = arena_push(frame_arenas + frame_idx, sizeof(VkExtensionProperties) * num, 0);
 	vkEnumerateDeviceExtensionProperties(gpu, NULL, &num, extensions);
 
 	for (i = 0; i < required_count; i++)
@@ -197,7 +198,7 @@ static sint check_device_extension_support(VkPhysicalDevice gpu)
 			if (strcmp(required[i], extensions[j].extensionName) == 0)
 				supported_count++;
 
-	free(extensions);
+	arena_rewind(frame_arenas + frame_idx, marker);
 	return supported_count == required_count;
 }
 
@@ -490,12 +491,10 @@ VkSurfaceFormatKHR get_surface_format(vk_device* device, VkSurfaceKHR surface)
 	VkSurfaceFormatKHR* formats;
 	VkSurfaceFormatKHR sdr = { VK_FORMAT_UNDEFINED, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR };
 	u32 count, i;
+	arena_marker marker = arena_mark(frame_arenas + frame_idx);
 
 	vkGetPhysicalDeviceSurfaceFormatsKHR(device->physical_device, surface, &count, NULL);
-	formats = calloc(count, sizeof(VkSurfaceFormatKHR));
-
-	if (formats == NULL)
-		return sdr;
+	formats = arena_push(frame_arenas + frame_idx, sizeof(VkSurfaceFormatKHR) * count, 0);
 
 	vkGetPhysicalDeviceSurfaceFormatsKHR(device->physical_device, surface, &count, formats);
 
@@ -517,7 +516,7 @@ VkSurfaceFormatKHR get_surface_format(vk_device* device, VkSurfaceKHR surface)
 
 	sdr = formats[i];
 ret:
-	free(formats);
+	arena_rewind(frame_arenas + frame_idx, marker);
 	return sdr;
 }
 
@@ -1265,6 +1264,7 @@ void draw_frame()
 
 	vkWaitForFences(device.handle, 1, device.done_fences + frame_idx, VK_TRUE, U64_MAX);
 	vkResetFences(device.handle, 1, device.done_fences + frame_idx);
+	arena_reset(frame_arenas + frame_idx);
 
 	while (1)
 	{
@@ -1312,8 +1312,26 @@ void draw_frame()
 	frame_idx = (frame_idx + 1) % g_rndcfg.parallel_frames;
 }
 
+arena* get_frame_arena()
+{
+	return frame_arenas + frame_idx;
+}
+
+allocator* get_frame_allocator()
+{
+	return frame_allocators + frame_idx;
+}
+
 void initialize_renderer()
 {
+	u32 i;
+
+	for (i = 0; i < MAX_PARALLEL_FRAMES; i++)
+	{
+		frame_arenas[i] = arena_init(FRAME_ARENA_SIZE);
+		frame_allocators[i] = arena_allocator(frame_arenas + i);
+	}
+
 	instance = create_instance();
 	create_device(&device);
 	create_descriptor_pool();
@@ -1323,10 +1341,15 @@ void initialize_renderer()
 
 void destroy_renderer()
 {
+	u32 i;
+
 	destroy_mesh();
 	vkDestroyDescriptorSetLayout(device.handle, g_default_descriptor_layout, NULL);
 	destroy_descriptor_pool();
 	destroy_command_pools(&device);
 	vkDestroyDevice(device.handle, NULL);
 	vkDestroyInstance(instance, NULL);
+
+	for (i = 0; i < MAX_PARALLEL_FRAMES; i++)
+		arena_destroy(frame_arenas + i);
 }
\ No newline at end of file
@@ -3,6 +3,7 @@
 
 
 #include "core.h"
+#include "allocator.h"
 #include "window.h"
 #include "vkrender.h"
 
@@ -33,4 +34,9 @@ void create_sync_objects();
 void destroy_sync_objects();
 void draw_frame();
 
+/* Scratch memory of the frame being recorded, valid until the same frame index comes around
+ * again. Containers can allocate from it through get_frame_allocator. */
+arena* get_frame_arena();
+allocator* get_frame_allocator();
+
 
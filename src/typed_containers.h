@@ -0,0 +1,285 @@
+#pragma once
+
+
+
+#include "containers.h"
+#include "hash.h"
+
+
+
+/**************************************************************************************************/
+/*	Type specialized containers
+ *
+ *	The generated types share their memory layout with 'vector' and 'flat_hashmap', so a typed
+ *	container can be passed to the generic functions through a cast. The hot paths are generated
+ *	inline with compile-time sizes, growth and shrinking go through the generic code. Type and
+ *	name arguments have to be single identifiers, typedef pointer types first. */
+
+
+
+/**************************************************************************************************/
+
+#define EQUAL_SCALAR(a, b) ((a) == (b))
+
+
+
+/**************************************************************************************************/
+
+/* Declares 'vector_T' with the functions of 'vector' taking and returning 'T' directly. */
+#define DECLARE_VECTOR(T) DECLARE_VECTOR_NAMED(vector_##T, T)
+
+#define DECLARE_VECTOR_NAMED(NAME, T)                                                               \
+                                                                                                    \
+typedef struct NAME                                                                                 \
+{                                                                                                   \
+	T* data;                                                                                        \
+	sint elem_size;                                                                                 \
+	sint len;                                                                                       \
+	sint cap;                                                                                       \
+	sint shrink;                                                                                    \
+	allocator* alloc;                                                                               \
+} NAME;                                                                                             \
+                                                                                                    \
+static inline NAME NAME##_init_alloc(sint len, allocator* alloc)                                    \
+{                                                                                                   \
+	NAME vec = { NULL, sizeof(T), 0, 0, CONTAINER_SHRINK_DEFAULT, alloc };                          \
+	vector_reserve((vector*)&vec, len);                                                             \
+	return vec;                                                                                     \
+}                                                                                                   \
+                                                                                                    \
+static inline NAME NAME##_init(sint len)                                                            \
+{                                                                                                   \
+	return NAME##_init_alloc(len, NULL);                                                            \
+}                                                                                                   \
+                                                                                                    \
+static inline void NAME##_destroy(NAME* vec)                                                        \
+{                                                                                                   \
+	vector_destroy((vector*)vec);                                                                   \
+}                                                                                                   \
+                                                                                                    \
+static inline void NAME##_reserve(NAME* vec, sint len)                                              \
+{                                                                                                   \
+	if (vec->cap < len)                                                                             \
+		vector_reserve((vector*)vec, len);                                                          \
+}                                                                                                   \
+                                                                                                    \
+static inline void NAME##_trim(NAME* vec)                                                           \
+{                                                                                                   \
+	vector_trim((vector*)vec);                                                                      \
+}                                                                                                   \
+                                                                                                    \
+static inline T* NAME##_get(NAME* vec, sint idx)                                                    \
+{                                                                                                   \
+	return vec->data + idx;                                                                         \
+}                                                                                                   \
+                                                                                                    \
+static inline void NAME##_insert(NAME* vec, T elem, sint idx)                                       \
+{                                                                                                   \
+	NAME##_reserve(vec, vec->len + 1);                                                              \
+	memmove(vec->data + idx + 1, vec->data + idx, sizeof(T) * (uptr)(vec->len - idx));             \
+	vec->data[idx] = elem;                                                                          \
+	vec->len++;                                                                                     \
+}                                                                                                   \
+                                                                                                    \
+static inline sint NAME##_push(NAME* vec, T elem)                                                   \
+{                                                                                                   \
+	NAME##_reserve(vec, vec->len + 1);                                                              \
+	vec->data[vec->len] = elem;                                                                     \
+	return vec->len++;                                                                              \
+}                                                                                                   \
+                                                                                                    \
+static inline void NAME##_erase(NAME* vec, sint idx)                                                \
+{                                                                                                   \
+	if (idx >= vec->len)                                                                            \
+		return;                                                                                     \
+                                                                                                    \
+	vec->len--;                                                                                     \
+	memmove(vec->data + idx, vec->data + idx + 1, sizeof(T) * (uptr)(vec->len - idx));             \
+                                                                                                    \
+	if (CONTAINER_SHOULD_SHRINK(vec))                                                               \
+		vector_trim((vector*)vec);                                                                  \
+}
+
+
+
+/**************************************************************************************************/
+
+/* Declares 'hashmap_K_V' with buckets of type 'hashmap_K_V_bucket' { K key; V value; }.
+ * 'HASH(key)' returns a sint, 'EQ(a, b)' returns non-zero if the keys are equal. Both are
+ * expanded inline, generic wrappers are stored in the map so 'flat_hashmap_*' keep working.
+ * The inline paths do not support incremental resizing. */
+#define DECLARE_HASHMAP(K, V, HASH, EQ) DECLARE_HASHMAP_NAMED(hashmap_##K##_##V, K, V, HASH, EQ)
+
+#define DECLARE_HASHMAP_NAMED(NAME, K, V, HASH, EQ)                                                 \
+                                                                                                    \
+typedef struct NAME##_bucket                                                                        \
+{                                                                                                   \
+	K key;                                                                                          \
+	V value;                                                                                        \
+} NAME##_bucket;                                                                                    \
+                                                                                                    \
+typedef struct NAME                                                                                 \
+{                                                                                                   \
+	NAME##_bucket* buckets;                                                                         \
+	u32* info;                                                                                      \
+	sint bucket_size;                                                                               \
+	sint len;                                                                                       \
+	sint cap;                                                                                       \
+	sint shrink;                                                                                    \
+	sint incremental;                                                                               \
+	allocator* alloc;                                                                               \
+	hashfunc hash;                                                                                  \
+	cmpfunc cmp;                                                                                    \
+	flat_hashmap_migration* migration;                                                              \
+} NAME;                                                                                             \
+                                                                                                    \
+static inline sint NAME##_bucket_hash(void* bucket)                                                  \
+{                                                                                                   \
+	return HASH(((NAME##_bucket*)bucket)->key);                                                     \
+}                                                                                                   \
+                                                                                                    \
+static inline sint NAME##_bucket_cmp(void* a, void* b)                                               \
+{                                                                                                   \
+	return !EQ(((NAME##_bucket*)a)->key, ((NAME##_bucket*)b)->key);                                 \
+}                                                                                                   \
+                                                                                                    \
+static inline NAME NAME##_init_alloc(sint len, allocator* alloc)                                    \
+{                                                                                                   \
+	flat_hashmap generic;                                                                           \
+	NAME map;                                                                                       \
+                                                                                                    \
+	generic = flat_hashmap_init_alloc(sizeof(NAME##_bucket), len, NAME##_bucket_hash,               \
+		NAME##_bucket_cmp, alloc);                                                                  \
+	memcpy(&map, &generic, sizeof(NAME));                                                           \
+	return map;                                                                                     \
+}                                                                                                   \
+                                                                                                    \
+static inline NAME NAME##_init(sint len)                                                            \
+{                                                                                                   \
+	return NAME##_init_alloc(len, NULL);                                                            \
+}                                                                                                   \
+                                                                                                    \
+static inline void NAME##_destroy(NAME* map)                                                        \
+{                                                                                                   \
+	flat_hashmap_destroy((flat_hashmap*)map);                                                       \
+}                                                                                                   \
+                                                                                                    \
+static inline void NAME##_reserve(NAME* map, sint len)                                              \
+{                                                                                                   \
+	if (len > (map->cap - (map->cap / 4)))                                                          \
+		flat_hashmap_reserve((flat_hashmap*)map, len);                                              \
+}                                                                                                   \
+                                                                                                    \
+static inline void NAME##_trim(NAME* map)                                                           \
+{                                                                                                   \
+	flat_hashmap_trim((flat_hashmap*)map);                                                          \
+}                                                                                                   \
+                                                                                                    \
+static inline NAME##_bucket* NAME##_get_index(NAME* map, sint hash, K key, sint* out_index)         \
+{                                                                                                   \
+	sint mask, idx, distance;                                                                       \
+	u32 fingerprint;                                                                                \
+                                                                                                    \
+	mask = map->cap - 1;                                                                            \
+	idx = hash & mask;                                                                              \
+	fingerprint = HASHMAP_INFO_HASH(HASHMAP_INFO_MAKE(hash, 0));                                    \
+                                                                                                    \
+	for (distance = 0;; idx = (idx + 1) & mask, distance++)                                         \
+	{                                                                                               \
+		u32 info = map->info[idx];                                                                  \
+                                                                                                    \
+		if ((info == HASHMAP_INFO_EMPTY) | (distance > (sint)HASHMAP_INFO_DISTANCE(info)))          \
+		{                                                                                           \
+			*out_index = idx;                                                                       \
+			return NULL;                                                                            \
+		}                                                                                           \
+		else if ((HASHMAP_INFO_HASH(info) == fingerprint) && EQ(key, map->buckets[idx].key))        \
+		{                                                                                           \
+			*out_index = idx;                                                                       \
+			return map->buckets + idx;                                                              \
+		}                                                                                           \
+	}                                                                                               \
+}                                                                                                   \
+                                                                                                    \
+static inline NAME##_bucket* NAME##_get(NAME* map, K key)                                           \
+{                                                                                                   \
+	sint idx;                                                                                       \
+	return NAME##_get_index(map, HASH(key), key, &idx);                                             \
+}                                                                                                   \
+                                                                                                    \
+static inline NAME##_bucket* NAME##_push(NAME* map, K key, V value)                                 \
+{                                                                                                   \
+	sint mask, hash, idx, distance;                                                                 \
+	NAME##_bucket* _bucket;                                                                         \
+	NAME##_bucket bucket;                                                                           \
+                                                                                                    \
+	NAME##_reserve(map, map->len + 1);                                                              \
+                                                                                                    \
+	hash = HASH(key);                                                                               \
+	_bucket = NAME##_get_index(map, hash, key, &idx);                                               \
+                                                                                                    \
+	if (_bucket != NULL)                                                                            \
+		return _bucket;                                                                             \
+                                                                                                    \
+	bucket.key = key;                                                                               \
+	bucket.value = value;                                                                           \
+	mask = map->cap - 1;                                                                            \
+	distance = ((map->cap + idx) - (hash & mask)) & mask;                                           \
+                                                                                                    \
+	for (;; idx = (idx + 1) & mask, distance++)                                                     \
+	{                                                                                               \
+		u32 info = map->info[idx];                                                                  \
+                                                                                                    \
+		if (info == HASHMAP_INFO_EMPTY)                                                             \
+		{                                                                                           \
+			map->buckets[idx] = bucket;                                                             \
+			map->info[idx] = HASHMAP_INFO_MAKE(hash, distance);                                     \
+			map->len++;                                                                             \
+			return NULL;                                                                            \
+		}                                                                                           \
+		else if (distance > (sint)HASHMAP_INFO_DISTANCE(info))                                      \
+		{                                                                                           \
+			NAME##_bucket tmp = map->buckets[idx];                                                  \
+                                                                                                    \
+			map->buckets[idx] = bucket;                                                             \
+			map->info[idx] = HASHMAP_INFO_MAKE(hash, distance);                                     \
+			bucket = tmp;                                                                           \
+			hash = (sint)HASHMAP_INFO_HASH(info);                                                   \
+			distance = HASHMAP_INFO_DISTANCE(info);                                                 \
+		}                                                                                           \
+	}                                                                                               \
+}                                                                                                   \
+                                                                                                    \
+static inline sint NAME##_pop(NAME* map, K key, NAME##_bucket* out_bucket)                          \
+{                                                                                                   \
+	sint mask, idx, next;                                                                           \
+	NAME##_bucket* _bucket;                                                                         \
+                                                                                                    \
+	_bucket = NAME##_get_index(map, HASH(key), key, &idx);                                          \
+                                                                                                    \
+	if (_bucket == NULL)                                                                            \
+		return INVALID_INDEX;                                                                       \
+                                                                                                    \
+	*out_bucket = *_bucket;                                                                         \
+	mask = map->cap - 1;                                                                            \
+                                                                                                    \
+	for (next = (idx + 1) & mask;; idx = next, next = (next + 1) & mask)                            \
+	{                                                                                               \
+		u32 next_info = map->info[next];                                                            \
+                                                                                                    \
+		if ((next_info == HASHMAP_INFO_EMPTY) | (HASHMAP_INFO_DISTANCE(next_info) == 0))            \
+		{                                                                                           \
+			map->info[idx] = HASHMAP_INFO_EMPTY;                                                    \
+			map->len--;                                                                             \
+			break;                                                                                  \
+		}                                                                                           \
+                                                                                                    \
+		map->buckets[idx] = map->buckets[next];                                                     \
+		map->info[idx] = next_info - 1;                                                             \
+	}                                                                                               \
+                                                                                                    \
+	if (CONTAINER_SHOULD_SHRINK(map))                                                               \
+		flat_hashmap_trim((flat_hashmap*)map);                                                      \
+                                                                                                    \
+	return SUCCESS;                                                                                 \
+}